@@ -12,10 +12,13 @@
 #include <core/MySensorsCore.h>
 #include <pwiCommon.h>
 #include "childids.h"
+#include "eeprom.h"
 #include "Linky.h"
 
 // HomeAssistant has issues with messages which are received too fast. So have unfortunately to wait sometime....
-#define WAITMS 5
+// The actual wait is adapted to the send outcomes between these two bounds (see Linky::sendMsg()).
+#define WAITMS        5
+#define WAITMS_MAX    160
 
 // uncomment for debug this class
 #define LINKY_DEBUG
@@ -40,36 +43,187 @@ const char CLy_Sep[] = { Car_HT, '\0' };
 
 #define CLy_MinLg     8                         /* Minimum useful message length */
 
+/* the _DNFR bitset */
+#define dnfrRead( etiq )    bitRead( this->_DNFR[( etiq ) >> 3], ( etiq ) & 7 )
+#define dnfrSet( etiq )     ( bitSet( this->_DNFR[( etiq ) >> 3], ( etiq ) & 7 ), epochWrite( etiq, seqEpoch( this->seq+1 )))
+#define dnfrReset()         memset( this->_DNFR, '\0', sizeof( this->_DNFR ))
+
+/* the epoch of a sequence number in the changes table, and the nibbles of this table */
+#define seqEpoch( seq )     (( uint8_t )((( seq ) >> LINKY_SEQ_SHIFT ) & 0x0f ))
+#define epochAge( e, etiq ) (( uint8_t )(( e )-epochRead( etiq )) & 0x0f )
+#define epochRead( etiq )   (( this->chg_epoch[( etiq ) >> 1] >> ((( etiq ) & 1 ) << 2 )) & 0x0f )
+#define epochWrite( etiq, e ) ( this->chg_epoch[( etiq ) >> 1] = ( this->chg_epoch[( etiq ) >> 1] & ( 0xf0 >> ((( etiq ) & 1 ) << 2 ))) | ((( e ) & 0x0f ) << ((( etiq ) & 1 ) << 2 )))
+
+/* the _PEND bitset */
+#define pendRead( etiq )    bitRead( this->_PEND[( etiq ) >> 3], ( etiq ) & 7 )
+#define pendClear( etiq )   bitClear( this->_PEND[( etiq ) >> 3], ( etiq ) & 7 )
+#define pendSet( etiq )     bitSet( this->_PEND[( etiq ) >> 3], ( etiq ) & 7 )
+
 P1(PLy_adsc)      = "ADSC";
 P1(PLy_vtic)      = "VTIC";
 P1(PLy_date)      = "DATE";
 P1(PLy_ngtf)      = "NGTF";
 P1(PLy_ltarf)     = "LTARF";
 P1(PLy_east)      = "EAST";
-P1(PLy_easf01)    = "EASF01";
-P1(PLy_easf02)    = "EASF02";
+P1(PLy_easf)      = "EASF";             /* EASF01..EASF10 */
+P1(PLy_easd)      = "EASD";             /* EASD01..EASD04 */
+P1(PLy_eait)      = "EAIT";
+P1(PLy_erq)       = "ERQ";              /* ERQ1..ERQ4 */
 P1(PLy_irms1)     = "IRMS1";
 P1(PLy_urms1)     = "URMS1";
 P1(PLy_pref)      = "PREF";
 P1(PLy_sinsts)    = "SINSTS";
 P1(PLy_smaxsn)    = "SMAXSN";
 P1(PLy_smaxsnm1)  = "SMAXSN-1";
+P1(PLy_sinsti)    = "SINSTI";
+P1(PLy_smaxin)    = "SMAXIN";
+P1(PLy_smaxinm1)  = "SMAXIN-1";
 P1(PLy_ccasn)     = "CCASN";
 P1(PLy_ccasnm1)   = "CCASN-1";
+P1(PLy_ccain)     = "CCAIN";
+P1(PLy_ccainm1)   = "CCAIN-1";
 P1(PLy_umoy1)     = "UMOY1";
 P1(PLy_stge)      = "STGE";
+P1(PLy_msg1)      = "MSG1";
+P1(PLy_msg2)      = "MSG2";
 P1(PLy_prm)       = "PRM";
+P1(PLy_relais)    = "RELAIS";
 P1(PLy_ntarf)     = "NTARF";
+P1(PLy_njourf)    = "NJOURF";
+P1(PLy_njourf1)   = "NJOURF+1";
+P1(PLy_pjourf1)   = "PJOURF+1";
 P1(PLy_hchp)      = "HCHP";
+P1(PLy_next)      = "Next tariff switch";
+P1(PLy_power)     = "Active power";
+P1(PLy_errors)    = "Decode errors";
+P1(PLy_timing)    = "Trame timing";
+P1(PLy_halfhour)  = "Half-hour power";
+P1(PLy_net)       = "Net power";
+P1(PLy_today)     = "Energy today";
+P1(PLy_month)     = "Energy this month";
+P1(PLy_dayc)      = "Energy closed days";
+P1(PLy_monthc)    = "Energy closed months";
+P1(PLy_queues)    = "Send queues";
+
+// the lower bounds of the histogram buckets (% of PREF)
+static const uint8_t st_hist_bounds[EEPROM_HISTOGRAM_SIZE] PROGMEM = { 100, 71, 50, 35, 25, 18, 12, 9, 6, 4, 0 };
+
+// the error classes, as sent on the errors child
+static const char st_errors[ler_count][6] PROGMEM = { "cks", "short", "ovf", "inval", "mono" };
+P1(PLy_nonutile)  = "NONUTILE";
 
 //                   1234567890123456
-P1(PLy_ngtf_HCHP) = "H PLEINE/CREUSE ";
-P1(PLy_ltarf_HP)  = " HEURE  PLEINE  ";
-P1(PLy_ltarf_HC)  = " HEURE  CREUSE  ";
+P1(PLy_pleine)    = "PLEINE";           /* LTARF keywords, whatever the spacing */
+P1(PLy_creuse)    = "CREUSE";
+P1(PLy_hp)        = "HP";               /* Tempo: 'HP BLEU', 'HC ROUGE', ... */
+P1(PLy_hc)        = "HC";
+
+/* the bit groups of the STGE status register (see Linky.h)
+ *  one-bit groups are presented as binary switches, others as numeric informations
+ */
+static const linky_stge_t st_stge[] PROGMEM = {
+    {  0, 1, CHILD_ID_STGE_DRY_CONTACT,    "Dry contact" },
+    {  1, 3, CHILD_ID_STGE_CUTOFF,         "Cut-off device" },
+    {  4, 1, CHILD_ID_STGE_COVER,          "Cover open" },
+    {  6, 1, CHILD_ID_STGE_OVERVOLTAGE,    "Overvoltage" },
+    {  7, 1, CHILD_ID_STGE_OVERLOAD,       "Overload" },
+    {  8, 1, CHILD_ID_STGE_PRODUCER,       "Producer" },
+    {  9, 1, CHILD_ID_STGE_NEGATIVE,       "Negative energy" },
+    { 10, 4, CHILD_ID_STGE_SUPPLIER,       "Supplier period" },
+    { 14, 2, CHILD_ID_STGE_DISTRIBUTOR,    "Distrib. period" },
+    { 16, 1, CHILD_ID_STGE_CLOCK,          "Degraded clock" },
+    { 17, 1, CHILD_ID_STGE_TIC_MODE,       "Standard TIC" },
+    { 19, 2, CHILD_ID_STGE_EURIDIS,        "Euridis output" },
+    { 21, 2, CHILD_ID_STGE_CPL_STATUS,     "CPL status" },
+    { 23, 1, CHILD_ID_STGE_CPL_SYNC,       "CPL synchronized" },
+    { 24, 2, CHILD_ID_STGE_TEMPO_TODAY,    "Tempo today" },
+    { 26, 2, CHILD_ID_STGE_TEMPO_TOMORROW, "Tempo tomorrow" },
+    { 28, 2, CHILD_ID_STGE_PEAK_NOTICE,    "Peak notice" },
+    { 30, 2, CHILD_ID_STGE_PEAK,           "Mobile peak" }
+};
+
+#define LINKY_STGE_COUNT    ( sizeof( st_stge ) / sizeof( linky_stge_t ))
+
+/* the items of a full report: the fields, the STGE groups, the running energy of the day and of the month,
+ * and the sequence number */
+#define LINKY_DUMP_COUNT    ( let_count+LINKY_STGE_COUNT+3 )
+
+P1(PLy_qalarm)    = "alarm";
+P1(PLy_qvalue)    = "value";
+P1(PLy_qdump)     = "dump";
+P1(PLy_qdiag)     = "diag";
+P1(PLy_qlog)      = "log";
+
+static const char * const st_queues[] PROGMEM = { PLy_qalarm, PLy_qvalue, PLy_qdump, PLy_qdiag, PLy_qlog };
+
+P1(PLy_loghp)     = "Change to HP";
+P1(PLy_loghc)     = "Change to HC";
+P1(PLy_logshon)   = "Load shedding on";
+P1(PLy_logshoff)  = "Load shedding off";
+
+static const char * const st_logs[llg_count] PROGMEM = { PLy_loghp, PLy_loghc, PLy_logshon, PLy_logshoff };
+
+#ifdef ICPSERIAL
+#define LINKY_ICP_ITEMS     1
+#else
+#define LINKY_ICP_ITEMS     0
+#endif
+
+/* the mask of the STGE bit group i */
+static uint32_t linkyStgeMask( uint8_t i )
+{
+    uint8_t shift = pgm_read_byte( &st_stge[i].shift );
+    uint8_t width = pgm_read_byte( &st_stge[i].width );
+    return((( 1UL << width )-1 ) << shift );
+}
+
+/* whether the value is a non-empty string of at most max printable chars */
+static bool linkyPrintable( const char *str, uint8_t max )
+{
+    uint8_t len = strlen( str );
+    if( !len || len > max ){
+        return( false );
+    }
+    for( ; *str ; ++str ){
+        if( !isprint( *str )){
+            return( false );
+        }
+    }
+    return( true );
+}
+
+/* the HP/HC meaning of a LTARF label: 1 if HP, 0 if HC, -1 if unknown (e.g. 'BASE') */
+static int8_t linkyLtarfHp( const char *label )
+{
+    while( *label == ' ' ){
+        label += 1;
+    }
+    if(( !strncmp_P( label, PLy_hp, 2 ) || !strncmp_P( label, PLy_hc, 2 )) && ( !label[2] || label[2] == ' ' )){
+        return( label[1] == 'P' ? 1 : 0 );
+    }
+    if( strstr_P( label, PLy_pleine )){
+        return( 1 );
+    }
+    if( strstr_P( label, PLy_creuse )){
+        return( 0 );
+    }
+    return( -1 );
+}
+
+/* djb2 string hash, never zero */
+static uint16_t linkyHash( const char *str )
+{
+    uint16_t h = 5381;
+    for( ; *str ; ++str ){
+        h = ( h << 5 ) + h + *str;
+    }
+    return( h ? h : 1 );
+}
 
 // Frequency of the trame LED (slow if OK, fast else)
 #define TRAMEOK_MS      3000
 #define TRAMENOTOK_MS   1000
+#define TRAMELEDON_MS    150
 
 /*************** Constructor, methods and properties ******************/
 
@@ -103,7 +257,7 @@ void Linky::init()
     this->hcPin = 0;
     this->hpPin = 0;
     this->_FR = 0;
-    this->_DNFR = 0;
+    dnfrReset();
     this->_pRec = _BfA;                 /* Receive in A */
     this->_pDec = _BfB;                 /* Decode in B */
 #ifdef LINKY_DEBUG
@@ -111,11 +265,95 @@ void Linky::init()
 #endif
     this->_iRec = 0;
     this->_iCks = 0;
+    this->_sRec = 0;
+    this->_iBlk = 0;
     this->_GId = 0;
+    this->_rebase = 0;
+    this->_sent = 0;
+    this->_fails = 0;
+    this->_stge = 0;
+    this->pace_ms = WAITMS;
+    this->send_ms = 0;
+    this->min_period_ms = 0;
     this->stx_ms = 0;
 
+    memset( this->sched, 0xff, sizeof( this->sched ));
+    memset( this->tic.pjourf1, 0xff, sizeof( this->tic.pjourf1 ));
+    this->tic.next = LINKY_SCHED_NONE;
+    this->sched_day = 0;
+    this->sched_seed = false;
+    this->sched_hp = 0;
+    this->sched_known = 0;
+    this->ltarf_hp = -1;
+
+    memset( &this->stat_irms1, '\0', sizeof( linky_stat_t ));
+    memset( &this->stat_urms1, '\0', sizeof( linky_stat_t ));
+    memset( &this->stat_sinsts, '\0', sizeof( linky_stat_t ));
+    this->cks_rate = 0;
+
+    memset( this->errors, '\0', sizeof( this->errors ));
+    memset( this->bad, '\0', sizeof( this->bad ));
+    this->bad_next = 0;
+
+    this->msg1[0] = '\0';
+    this->msg2[0] = '\0';
+    memset( this->msg_hash, '\0', sizeof( this->msg_hash ));
+    this->msg_pend = 0;
+    this->msg_fail = 0;
+
+    this->first_ms = 0;
+    this->ifi_avg = 0;
+    this->ifi_max = 0;
+    this->dur_avg = 0;
+    this->dur_max = 0;
+    this->drift_ms = 0;
+    this->drift_s = 0;
+    this->drift_sod = LINKY_POWER_NONE;
+    this->drift_ppm = 0;
+    this->hh_slot = LINKY_HALFHOUR_NONE;
+    this->hh_east = 0;
+
+    this->power_east = 0;
+    this->power_s = LINKY_POWER_NONE;
+    this->power_acc = LINKY_POWER_NONE;
+    this->producer = false;
+
+    this->hist_pref = 0;
+    memset( this->hist_add, '\0', sizeof( this->hist_add ));
+    this->hist_every = 0;
+
+    this->energy_day[0] = '\0';
+    this->energy_s = LINKY_POWER_NONE;
+    memset( this->energy_day_base, '\0', sizeof( this->energy_day_base ));
+    memset( this->energy_base, '\0', sizeof( this->energy_base ));
+    this->energy_exact = 0;
+    this->energy_closed[0] = '\0';
+    memset( this->energy_close, '\0', sizeof( this->energy_close ));
+    this->energy_pend = 0;
+
+    memset( this->_PEND, '\0', sizeof( this->_PEND ));
+    this->_stge_pend = 0;
+    this->dump_next = LINKY_DUMP_NONE;
+    this->log_pend = 0;
+    this->log_text[0] = '\0';
+    this->diag_pend = 0;
+    this->diag_cur = ldg_count;
+    this->diag_next = 0;
+    this->diag_child = 0;
+    this->seq_pend = false;
+    this->seqStart( 0 );
+    memset( this->q_since, '\0', sizeof( this->q_since ));
+    memset( this->q_sent, '\0', sizeof( this->q_sent ));
+    memset( this->q_depth, '\0', sizeof( this->q_depth ));
+    memset( this->q_lat, '\0', sizeof( this->q_lat ));
+
+    memset( this->rules, '\0', sizeof( this->rules ));
+    memset( this->rules_count, '\0', sizeof( this->rules_count ));
+    this->rules_on = 0;
+
     // logs are always ignored at startup
     this->log_ignored = false;
+    memset( this->ignored, '\0', sizeof( this->ignored ));
 };
 
 // LED initialization
@@ -129,6 +367,118 @@ void Linky::init_led( uint8_t *dest, uint8_t pin )
     }
 }
 
+/**
+ * Linky::indexFind:
+ * @label: the label of an information group.
+ * 
+ * Returns: the index in tic.index[] of an EASFnn or EASDnn label,
+ *  or LINKY_INDEX_COUNT if the label is not an energy index.
+ *
+ * Private.
+ */
+uint8_t Linky::indexFind( const char *label )
+{
+    if( strlen( label ) == LINKY_INDEX_LABEL && isdigit( label[4] ) && isdigit( label[5] )){
+        uint8_t n = 10*( label[4]-'0' )+( label[5]-'0' );
+        if( !strncmp_P( label, PLy_easf, 4 ) && n >= 1 && n <= LINKY_INDEX_EASF ){
+            return( n-1 );
+        }
+        if( !strncmp_P( label, PLy_easd, 4 ) && n >= 1 && n <= LINKY_INDEX_EASD ){
+            return( LINKY_INDEX_EASF+n-1 );
+        }
+    }
+    return( LINKY_INDEX_COUNT );
+}
+
+/**
+ * Linky::indexLabel:
+ * @idx: the index in tic.index[].
+ * @buffer: a buffer of at least 1+LINKY_INDEX_LABEL bytes.
+ * 
+ * Returns: @buffer, filled with the label of the energy index.
+ *
+ * Private.
+ */
+char *Linky::indexLabel( uint8_t idx, char *buffer )
+{
+    uint8_t n = idx+1;
+    if( idx < LINKY_INDEX_EASF ){
+        strcpy_P( buffer, PLy_easf );
+    } else {
+        strcpy_P( buffer, PLy_easd );
+        n -= LINKY_INDEX_EASF;
+    }
+    buffer[4] = '0'+n/10;
+    buffer[5] = '0'+n%10;
+    buffer[6] = '\0';
+    return( buffer );
+}
+
+/**
+ * Linky::errorsItem:
+ * @item: the item of the errors report.
+ * 
+ * Send the decode errors counters as 'class=count', then the captured groups as 'n:group', the most
+ * recent first.
+ *
+ * Returns: %TRUE if a message has been sent (an empty capture slot is skipped).
+ *
+ * Private.
+ */
+bool Linky::errorsItem( uint8_t item )
+{
+    MyMessage msg;
+    char buffer[1+MAX_PAYLOAD];
+
+    if( item < ler_count ){
+        strcpy_P( buffer, st_errors[item] );
+        strcat( buffer, "=" );
+        utoa( this->errors[item], buffer+strlen( buffer ), 10 );
+#ifdef ICPSERIAL
+    } else if( item == ler_count ){
+        strcpy( buffer, "parity=" );
+        utoa( this->linkySerial.getErrors(), buffer+strlen( buffer ), 10 );
+#endif
+    } else {
+        uint8_t i = item-ler_count-LINKY_ICP_ITEMS+1;
+        const char *bad = this->bad[( this->bad_next+LINKY_BAD_COUNT-i ) % LINKY_BAD_COUNT];
+        if( !bad[0] ){
+            return( false );
+        }
+        buffer[0] = '0'+i;
+        buffer[1] = ':';
+        strcpy( buffer+2, bad );
+    }
+    msg.clear();
+    this->sendMsg( msg.setSensor( CHILD_ID_ERRORS ).setType( V_TEXT ).set( buffer ));
+    return( true );
+}
+
+/**
+ * Linky::errorsSend:
+ * 
+ * Queue the decode errors report (see errorsItem()).
+ *
+ * Public.
+ */
+void Linky::errorsSend( void )
+{
+    this->diagQueue( ldg_errors );
+}
+
+/**
+ * Linky::isIdle:
+ * 
+ * Returns: %TRUE if there is nothing to do until the next received character,
+ *  i.e. the MCU may sleep until the next interrupt.
+ *
+ * Public.
+ */
+bool Linky::isIdle( void )
+{
+    return( !bitRead( this->_FR, lst_Dec ) && !bitRead( this->_FR, lst_Etx ) && !this->linkySerial.available() && this->queuesEmpty());
+}
+
 /**
  * Linky::ledOff:
  * @pin: the number of the pin to which the LED is attached.
@@ -176,11 +526,16 @@ bool Linky::logIgnoredGet( void )
  * Linky::logIgnoredSet:
  * @status: whether we want log ignored information groups.
  *
+ * Setting the flag restarts the inventory, so that all ignored labels are reported again.
+ *
  * Public.
  */
 void Linky::logIgnoredSet( bool status )
 {
     this->log_ignored = status;
+    if( status ){
+        memset( this->ignored, '\0', sizeof( this->ignored ));
+    }
 }
 
 /**
@@ -194,19 +549,10 @@ void Linky::logIgnoredSet( bool status )
  */
 void Linky::loop()
 {
-    /* 1st part, last action : decode information */
-    if( bitRead( this->_FR, lst_Dec )){
-        bitClear( this->_FR, lst_Dec );
-#ifdef LINKY_DEBUG
-        Serial.print( this->_pDec );
-#endif
-        this->ig_decode();
-#ifdef LINKY_DEBUG
-        Serial.println();
-#endif
-    }
-    /* 2th part, receiver processing - always run */
-    this->ig_receive();
+    /* decode, commit and receive */
+    this->ig_process();
+    /* then send at most one queued message */
+    this->sendNext();
 }
 
 /**
@@ -214,172 +560,320 @@ void Linky::loop()
  * 
  * Présentation MySensors.
  *
+ * Returns: %TRUE if all the presentations have been sent.
+ *
+ * Public.
+ */
+bool Linky::present()
+{
+    bool ok = true;
+    this->presentWait();
+    ok &= ::present( CHILD_ID_ADSC,     S_INFO,       PGMSTR( PLy_adsc ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_VTIC,     S_INFO,       PGMSTR( PLy_vtic ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_DATE,     S_INFO,       PGMSTR( PLy_date ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_NGTF,     S_INFO,       PGMSTR( PLy_ngtf ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_LTARF,    S_INFO,       PGMSTR( PLy_ltarf ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_EAST,     S_POWER,      PGMSTR( PLy_east ));
+    char label[1+LINKY_INDEX_LABEL];
+    for( uint8_t i=0 ; i<LINKY_INDEX_COUNT ; ++i ){
+        this->presentWait();
+        ok &= ::present( CHILD_ID_EASF01+i, S_POWER,      this->indexLabel( i, label ));
+    }
+    this->presentWait();
+    ok &= ::present( CHILD_ID_EAIT,     S_POWER,      PGMSTR( PLy_eait ));
+    for( uint8_t i=0 ; i<LINKY_ERQ_COUNT ; ++i ){
+        strcpy_P( label, PLy_erq );
+        label[3] = '1'+i;
+        label[4] = '\0';
+        this->presentWait();
+        ok &= ::present( CHILD_ID_ERQ1+i, S_POWER,        label );
+    }
+    this->presentWait();
+    ok &= ::present( CHILD_ID_IRMS1,    S_MULTIMETER, PGMSTR( PLy_irms1 ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_URMS1,    S_MULTIMETER, PGMSTR( PLy_urms1 ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_PREF,     S_POWER,      PGMSTR( PLy_pref ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_SINSTS,   S_POWER,      PGMSTR( PLy_sinsts ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_SMAXSN,   S_POWER,      PGMSTR( PLy_smaxsn ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_SMAXSN_1, S_POWER,      PGMSTR( PLy_smaxsnm1 ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_SINSTI,   S_POWER,      PGMSTR( PLy_sinsti ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_SMAXIN,   S_POWER,      PGMSTR( PLy_smaxin ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_SMAXIN_1, S_POWER,      PGMSTR( PLy_smaxinm1 ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_CCASN,    S_POWER,      PGMSTR( PLy_ccasn ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_CCASN_1,  S_POWER,      PGMSTR( PLy_ccasnm1 ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_CCAIN,    S_POWER,      PGMSTR( PLy_ccain ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_CCAIN_1,  S_POWER,      PGMSTR( PLy_ccainm1 ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_UMOY1,    S_MULTIMETER, PGMSTR( PLy_umoy1 ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_STGE,     S_INFO,       PGMSTR( PLy_stge ));
+    linky_stge_t grp;
+    for( uint8_t i=0 ; i<LINKY_STGE_COUNT ; ++i ){
+        memcpy_P( &grp, &st_stge[i], sizeof( linky_stge_t ));
+        this->presentWait();
+        ok &= ::present( grp.child, grp.width == 1 ? S_BINARY : S_INFO, grp.label );
+    }
+    this->presentWait();
+    ok &= ::present( CHILD_ID_MSG1,     S_INFO,       PGMSTR( PLy_msg1 ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_MSG2,     S_INFO,       PGMSTR( PLy_msg2 ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_PRM,      S_INFO,       PGMSTR( PLy_prm ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_RELAIS,   S_INFO,       PGMSTR( PLy_relais ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_NTARF,    S_INFO,       PGMSTR( PLy_ntarf ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_NJOURF,   S_INFO,       PGMSTR( PLy_njourf ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_NJOURF_1, S_INFO,       PGMSTR( PLy_njourf1 ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_HCHP,     S_BINARY,     PGMSTR( PLy_hchp ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_NEXT_SWITCH, S_INFO,    PGMSTR( PLy_next ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_POWER,    S_POWER,      PGMSTR( PLy_power ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_ERRORS,   S_INFO,       PGMSTR( PLy_errors ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_TIMING,   S_INFO,       PGMSTR( PLy_timing ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_HALFHOUR, S_POWER,      PGMSTR( PLy_halfhour ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_NET_POWER, S_POWER,     PGMSTR( PLy_net ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_ENERGY_TODAY, S_POWER,  PGMSTR( PLy_today ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_ENERGY_MONTH, S_POWER,  PGMSTR( PLy_month ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_ENERGY_DAY_CLOSED, S_INFO, PGMSTR( PLy_dayc ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_ENERGY_MONTH_CLOSED, S_INFO, PGMSTR( PLy_monthc ));
+    this->presentWait();
+    ok &= ::present( CHILD_ID_QUEUES,   S_INFO,       PGMSTR( PLy_queues ));
+    return( ok );
+}
+
+/**
+ * Linky::presentWait:
+ * 
+ * Wait for the pacing delay before the next presentation, while still receiving and decoding the TIC,
+ * so that no trame is lost during the presentation. Nothing is sent from the queues meanwhile.
+ *
+ * Public.
+ */
+void Linky::presentWait( void )
+{
+    uint32_t start = millis();
+    do {
+        wait( 1 );
+        this->ig_process();
+    } while( millis()-start < this->pace_ms );
+}
+
+/**
+ * Linky::queuesItem:
+ * @item: the queue.
+ * 
+ * Send the metrics of the queue as 'name=sent/depth/max/latency' ('log=sent/deferred'), and restart
+ * the max after the last queue.
+ *
+ * Returns: %TRUE.
+ *
+ * Private.
+ */
+bool Linky::queuesItem( uint8_t item )
+{
+    MyMessage msg;
+    char buffer[1+MAX_PAYLOAD];
+
+    strcpy_P( buffer, ( const char * ) pgm_read_word( &st_queues[item] ));
+    strcat( buffer, "=" );
+    utoa( this->q_sent[item], buffer+strlen( buffer ), 10 );
+    strcat( buffer, "/" );
+    if( item != lqu_log ){
+        utoa( this->queueDepth( item ), buffer+strlen( buffer ), 10 );
+        strcat( buffer, "/" );
+    }
+    utoa( this->q_depth[item], buffer+strlen( buffer ), 10 );
+    if( item != lqu_log ){
+        strcat( buffer, "/" );
+        utoa( this->q_lat[item], buffer+strlen( buffer ), 10 );
+    }
+    msg.clear();
+    this->sendMsg( msg.setSensor( CHILD_ID_QUEUES ).setType( V_TEXT ).set( buffer ));
+
+    if( item == lqu_count-1 ){
+        memset( this->q_depth, '\0', sizeof( this->q_depth ));
+        memset( this->q_lat, '\0', sizeof( this->q_lat ));
+    }
+    return( true );
+}
+
+/**
+ * Linky::queuesSend:
+ * 
+ * Queue the send queues metrics report (see queuesItem()).
+ *
  * Public.
  */
-void Linky::present()
-{
-    wait( WAITMS );
-    ::present( CHILD_ID_ADSC,     S_INFO,       PGMSTR( PLy_adsc ));
-    wait( WAITMS );
-    ::present( CHILD_ID_VTIC,     S_INFO,       PGMSTR( PLy_vtic ));
-    wait( WAITMS );
-    ::present( CHILD_ID_DATE,     S_INFO,       PGMSTR( PLy_date ));
-    wait( WAITMS );
-    ::present( CHILD_ID_NGTF,     S_INFO,       PGMSTR( PLy_ngtf ));
-    wait( WAITMS );
-    ::present( CHILD_ID_LTARF,    S_INFO,       PGMSTR( PLy_ltarf ));
-    wait( WAITMS );
-    ::present( CHILD_ID_EAST,     S_POWER,      PGMSTR( PLy_east ));
-    wait( WAITMS );
-    ::present( CHILD_ID_EASF01,   S_POWER,      PGMSTR( PLy_easf01 ));
-    wait( WAITMS );
-    ::present( CHILD_ID_EASF02,   S_POWER,      PGMSTR( PLy_easf02 ));
-    wait( WAITMS );
-    ::present( CHILD_ID_IRMS1,    S_MULTIMETER, PGMSTR( PLy_irms1 ));
-    wait( WAITMS );
-    ::present( CHILD_ID_URMS1,    S_MULTIMETER, PGMSTR( PLy_urms1 ));
-    wait( WAITMS );
-    ::present( CHILD_ID_PREF,     S_POWER,      PGMSTR( PLy_pref ));
-    wait( WAITMS );
-    ::present( CHILD_ID_SINSTS,   S_POWER,      PGMSTR( PLy_sinsts ));
-    wait( WAITMS );
-    ::present( CHILD_ID_SMAXSN,   S_POWER,      PGMSTR( PLy_smaxsn ));
-    wait( WAITMS );
-    ::present( CHILD_ID_SMAXSN_1, S_POWER,      PGMSTR( PLy_smaxsnm1 ));
-    wait( WAITMS );
-    ::present( CHILD_ID_CCASN,    S_POWER,      PGMSTR( PLy_ccasn ));
-    wait( WAITMS );
-    ::present( CHILD_ID_CCASN_1,  S_POWER,      PGMSTR( PLy_ccasnm1 ));
-    wait( WAITMS );
-    ::present( CHILD_ID_UMOY1,    S_MULTIMETER, PGMSTR( PLy_umoy1 ));
-    wait( WAITMS );
-    ::present( CHILD_ID_STGE,     S_INFO,       PGMSTR( PLy_stge ));
-    wait( WAITMS );
-    ::present( CHILD_ID_PRM,      S_INFO,       PGMSTR( PLy_prm ));
-    wait( WAITMS );
-    ::present( CHILD_ID_NTARF,    S_INFO,       PGMSTR( PLy_ntarf ));
-    wait( WAITMS );
-    ::present( CHILD_ID_HCHP,     S_BINARY,     PGMSTR( PLy_hchp ));
+void Linky::queuesSend( void )
+{
+    this->diagQueue( ldg_queues );
+}
+
+/**
+ * Linky::resync:
+ * @since: the last sequence number known by the controller.
+ * 
+ * Queue the fields which have changed since @since, or a full report if @since is unknown, and send
+ * the current sequence number.
+ *
+ * Public.
+ */
+void Linky::resync( uint16_t since )
+{
+    if( !bitRead( this->_FR, lst_Val )){
+        return;
+    }
+    uint16_t age = this->seq+1-since;
+#ifdef LINKY_DEBUG
+    Serial.print( F( "Linky::resync() since=" )); Serial.print( since );
+    Serial.print( F( ", seq=" )); Serial.println( this->seq );
+#endif
+    if( !age || age > this->seq_count+1 || age >= LINKY_SEQ_WINDOW ){
+        this->send( true );
+    } else {
+        uint8_t epoch = seqEpoch( this->seq+1 );
+        uint8_t limit = ( epoch-seqEpoch( since )) & 0x0f;
+        uint8_t before = this->queueDepth( lqu_value );
+        for( uint8_t i=0 ; i<let_count ; ++i ){
+            if( epochAge( epoch, i ) <= limit ){
+                pendSet( i );
+            }
+        }
+        if( pendRead( let_stge )){
+            for( uint8_t i=0 ; i<LINKY_STGE_COUNT ; ++i ){
+                this->_stge_pend |= linkyStgeMask( i );
+            }
+        }
+        this->queueAdded( lqu_value, before );
+        /* messages are queued on decode, have them queued again with the next trame */
+        memset( this->msg_hash, '\0', sizeof( this->msg_hash ));
+    }
+    this->seqSend();
 }
 
 /**
  * Linky::send:
+ * @all: whether to send all the informations, or only the changed ones.
  * 
- * Unconditionally send the informations.
+ * Queue the informations to be sent, the messages being actually sent from loop() (see sendNext()).
+ * Changed values are queued with their last value, whatever the count of their changes.
  *
  * Public.
  */
 void Linky::send( bool all /*=false*/ )
 {
-    MyMessage msg;
-    uint8_t id = this->id;
-
-    if( all || bitRead( this->_DNFR, let_adsc )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_ADSC ).setType( V_TEXT ).set( this->tic.adsc ));
-    }
-    if( all || bitRead( this->_DNFR, let_vtic )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_VTIC ).setType( V_TEXT ).set( this->tic.vtic ));
-    }
-    if( all || bitRead( this->_DNFR, let_date )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_DATE ).setType( V_TEXT ).set( this->tic.date ));
-    }
-    if( all || bitRead( this->_DNFR, let_ngtf )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_NGTF ).setType( V_TEXT ).set( this->tic.ngtf ));
-    }
-    if( all || bitRead( this->_DNFR, let_ltarf )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_LTARF ).setType( V_TEXT ).set( this->tic.ltarf ));
-    }
-    if( all || bitRead( this->_DNFR, let_east )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_EAST ).setType( V_KWH ).set( this->tic.east / 1000.0, 3 ));
-    }
-    if( all || bitRead( this->_DNFR, let_easf01 )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_EASF01 ).setType( V_KWH ).set( this->tic.easf01 / 1000.0, 3 ));
-    }
-    if( all || bitRead( this->_DNFR, let_easf02 )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_EASF02 ).setType( V_KWH ).set( this->tic.easf02 / 1000.0, 3 ));
-    }
-    if( all || bitRead( this->_DNFR, let_irms1 )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_IRMS1 ).setType( V_CURRENT ).set( this->tic.irms1 ));
-    }
-    if( all || bitRead( this->_DNFR, let_urms1 )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_URMS1 ).setType( V_VOLTAGE ).set( this->tic.urms1 ));
-    }
-    if( all || bitRead( this->_DNFR, let_pref )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_PREF ).setType( V_VA ).set( this->tic.pref * 1000 ));
-    }
-    if( all || bitRead( this->_DNFR, let_sinsts )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_SINSTS ).setType( V_VA ).set( this->tic.sinsts ));
-    }
-    if( all || bitRead( this->_DNFR, let_smaxsn )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_SMAXSN ).setType( V_VA ).set( this->tic.smaxsn.value ));
-    }
-    if( all || bitRead( this->_DNFR, let_smaxsnm1 )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_SMAXSN_1 ).setType( V_VA ).set( this->tic.smaxsnm1.value ));
-    }
-    if( all || bitRead( this->_DNFR, let_ccasn )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_CCASN ).setType( V_WATT ).set( this->tic.ccasn.value ));
-    }
-    if( all || bitRead( this->_DNFR, let_ccasnm1 )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_CCASN_1 ).setType( V_WATT ).set( this->tic.ccasnm1.value ));
-    }
-    if( all || bitRead( this->_DNFR, let_umoy1 )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_UMOY1 ).setType( V_VOLTAGE ).set( this->tic.umoy1.value ));
-    }
-    if( all || bitRead( this->_DNFR, let_stge )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_STGE ).setType( V_TEXT ).set( this->tic.stge ));
-    }
-    if( all || bitRead( this->_DNFR, let_prm )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_PRM ).setType( V_TEXT ).set( this->tic.prm ));
-    }
-    if( all || bitRead( this->_DNFR, let_ntarf )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_NTARF ).setType( V_TEXT ).set( this->tic.ntarf ));
-    }
-    if( all || bitRead( this->_DNFR, let_hchp )){
-        msg.clear();
-        wait( WAITMS );
-        ::send( msg.setSensor( CHILD_ID_HCHP ).setType( V_STATUS ).set( this->tic.hchp ));
-    }
-    this->_DNFR = 0;
+    this->pace();
+    this->_sent = 0;
+    this->_fails = 0;
+
+    if( all ){
+        uint8_t before = this->queueDepth( lqu_dump );
+        this->dump_next = 0;
+        this->queueAdded( lqu_dump, before );
+        /* messages are queued on decode, have them queued again with the next trame */
+        memset( this->msg_hash, '\0', sizeof( this->msg_hash ));
+    } else {
+        uint8_t before = this->queueDepth( lqu_value );
+        for( uint8_t i=0 ; i<sizeof( this->_PEND ) ; ++i ){
+            this->_PEND[i] |= this->_DNFR[i];
+        }
+        this->_stge_pend |= this->_stge;
+        this->queueAdded( lqu_value, before );
+        /* have the controller know up to which trame it has got the changes */
+        if( this->queueDepth( lqu_value ) > before ){
+            this->seqSend();
+        }
+    }
+    /* a full report covers the changed values too */
+    dnfrReset();
+    this->_stge = 0;
+}
+
+/**
+ * Linky::seqSend:
+ * 
+ * Queue the sequence number of the last committed trame, which is sent after the changed values.
+ * When it is already queued, the older number is kept, as all the changes up to the newer one may not
+ * have been sent yet.
+ *
+ * Public.
+ */
+void Linky::seqSend( void )
+{
+    if( !this->seq_pend ){
+        uint8_t before = this->queueDepth( lqu_value );
+        this->seq_ack = this->seq;
+        this->seq_pend = true;
+        this->queueAdded( lqu_value, before );
+    }
+}
+
+/**
+ * Linky::setPeriods:
+ * @min_period_ms: minimal period for sending changes (max frequency).
+ * @max_period_ms: maximal period for sending data (unchanged timeout).
+ * 
+ * Update the configured periods.
+ * @min_period_ms is the floor of the adaptive min period, @max_period_ms its ceiling.
+ *
+ * Public.
+ */
+void Linky::setPeriods( uint32_t min_period_ms, uint32_t max_period_ms )
+{
+    this->min_period_ms = min_period_ms;
+    this->min_period.setDelay( min_period_ms );
+    this->max_period.setDelay( max_period_ms );
+}
+
+/**
+ * Linky::setRules:
+ * @rules: the EEPROM_RULES load shedding rules.
+ * 
+ * Update the load shedding rules.
+ * The pins of the previous rules are released (set LOW), the new ones are set as outputs.
+ *
+ * Public.
+ */
+void Linky::setRules( const sRule *rules )
+{
+    for( uint8_t i=0 ; i<EEPROM_RULES ; ++i ){
+        this->ledOff( this->rules[i].pin );
+    }
+    memcpy( this->rules, rules, sizeof( this->rules ));
+    memset( this->rules_count, '\0', sizeof( this->rules_count ));
+    this->rules_on = 0;
+    for( uint8_t i=0 ; i<EEPROM_RULES ; ++i ){
+        this->init_led( &this->rules[i].pin, this->rules[i].pin );
+    }
 }
 
 /**
@@ -398,14 +892,17 @@ void Linky::setup( uint32_t min_period_ms, uint32_t max_period_ms )
     Serial.print( F( "Linky::setup() sizeof(tic_t)=" )); Serial.println( sizeof( tic_t ));
 #endif
 
-    /* Initialize the SoftwareSerial */
+    /* Initialize the SoftwareSerial (or the input capture port, which owns its pin) */
+#ifndef ICPSERIAL
     uint8_t rxPin = this->rxPin;
     pinMode( rxPin, INPUT );
     pinMode( CLy_TxPin, OUTPUT );
+#endif
     linkySerial.begin( CLy_Bds );
 
     /* setup the min_period (max frequency) and max_period (unchanged timeout) timers
      */
+    this->min_period_ms = min_period_ms;
     this->min_period.setup( "MinPeriod", min_period_ms, false, Linky::MinPeriodCb, this );
     this->min_period.start();
     this->max_period.setup( "MaxPeriod", max_period_ms, false, Linky::MaxPeriodCb, this );
@@ -415,15 +912,83 @@ void Linky::setup( uint32_t min_period_ms, uint32_t max_period_ms )
      *  the status LED  is visible on the front panel, we so manage it with a hardware timer
      *  light up delay is 0.1s (0 +0.1) -> set up with 150 ms
      */
-    this->led_on_timer.setup( "LedOn", 150, true, Linky::TrameLedOnCb, this );
-    this->led_status_timer.setup( "Status", TRAMEOK_MS, false, Linky::TrameLedStatusCb, this );
+    this->led_period_ms = 0;
+    this->led_timer.setup( "Led", TRAMELEDON_MS, true, Linky::TrameLedCb, this );
     this->timeout_timer.setup( "Timeout", 10000, true, Linky::TrameTimeoutCb, this );
 
     /* light on the trame led */
     this->trameLedSet( TRAMENOTOK_MS );
 
-    // send a first value for all sensors
-    this->send( true );
+    /* restore the last checkpointed energy indexes, so that they are validated against a known baseline
+     *  the first values are sent when the first valid trame is committed
+     */
+    sCheckpoint cp;
+    if( eepromCheckpointRead( cp, loadState )){
+        this->tic.east = cp.east;
+        this->tic.index[0] = cp.easf01;
+        this->tic.index[1] = cp.easf02;
+        this->tic.eait = cp.eait;
+        memcpy( this->tic.erq, cp.erq, sizeof( cp.erq ));
+#ifdef LINKY_DEBUG
+        Serial.print( F( "Linky::setup() restored EAST=" )); Serial.println( cp.east );
+#endif
+    }
+    this->checkpoint_timer.setup( "Checkpoint", LINKY_CHECKPOINT_MS, false, Linky::CheckpointCb, this );
+    this->checkpoint_timer.start();
+}
+
+#ifdef LINKY_CAPTURE
+/**
+ * Linky::capture:
+ * @c: the received char.
+ * 
+ * Echo the char on the debug serial port with its high bit set, followed by the reception time if it
+ * is a STX.
+ *
+ * Private.
+ */
+void Linky::capture( char c )
+{
+    Serial.write( 0x80 | c );
+    if( c == Car_STX ){
+        uint32_t now = millis();
+        for( uint8_t i=0 ; i<5 ; ++i ){
+            Serial.write( 0x80 | ( now & 0x7f ));
+            now >>= 7;
+        }
+    }
+}
+#endif
+
+/**
+ * Linky::checkpoint:
+ * 
+ * Save the energy indexes in the EEPROM if they have changed since the last checkpoint.
+ * Save the histogram every LINKY_HISTOGRAM_EVERY checkpoints.
+ *
+ * Private.
+ */
+void Linky::checkpoint()
+{
+    if( bitRead( this->_FR, lst_Cp )){
+        bitClear( this->_FR, lst_Cp );
+        sCheckpoint cp;
+        cp.east = this->tic.east;
+        cp.easf01 = this->tic.index[0];
+        cp.easf02 = this->tic.index[1];
+        cp.eait = this->tic.eait;
+        memcpy( cp.erq, this->tic.erq, sizeof( cp.erq ));
+        eepromCheckpointWrite( cp, saveState );
+    }
+    if( ++this->hist_every >= LINKY_HISTOGRAM_EVERY ){
+        this->hist_every = 0;
+        if( this->hist_pref ){
+            sHistogram hist;
+            this->histogramTotal( hist );
+            eepromHistogramWrite( hist, saveState );
+            memset( this->hist_add, '\0', sizeof( this->hist_add ));
+        }
+    }
 }
 
 /**
@@ -468,14 +1033,13 @@ bool Linky::decData( char *dest, linky_etiq_t etiq )
     // advance _pDec until the value
     this->_pDec = strtok( NULL, CLy_Sep );
     bool valid = false;
-    bool hchp = false;
-    uint8_t count;
+    uint8_t count = 0;
 
     // check data validity
     switch( etiq ){
         case let_adsc:
             if( strlen( this->_pDec ) == LINKY_ADSC_SIZE ){
-                for( uint8_t i=0, count=0 ; this->_pDec[i] ; ++i ){
+                for( uint8_t i=0 ; this->_pDec[i] ; ++i ){
                     if( !isdigit( this->_pDec[i] )){
                         count += 1;
                         break;
@@ -493,23 +1057,21 @@ bool Linky::decData( char *dest, linky_etiq_t etiq )
             valid = this->checkHorodate( this->_pDec );
             break;
 
+        /* any well-formed label is accepted, an unknown one just does not tell HP nor HC */
         case let_ngtf:
-            valid = ( strcmp_P( this->_pDec, PLy_ngtf_HCHP ) == 0 );
+            valid = linkyPrintable( this->_pDec, LINKY_NGTF_SIZE );
             break;
 
         case let_ltarf:
-            if( !strcmp_P( this->_pDec, PLy_ltarf_HP )){
-                hchp = true;
-                valid = true;
-            } else if( !strcmp_P( this->_pDec, PLy_ltarf_HC )){
-                hchp = false;
-                valid = true;
+            valid = linkyPrintable( this->_pDec, LINKY_LTARF_SIZE );
+            if( valid ){
+                this->ltarf_hp = linkyLtarfHp( this->_pDec );
             }
             break;
 
         case let_prm:
             if( strlen( this->_pDec ) == LINKY_PRM_SIZE ){
-                for( uint8_t i=0, count=0 ; this->_pDec[i] ; ++i ){
+                for( uint8_t i=0 ; this->_pDec[i] ; ++i ){
                     if( !isdigit( this->_pDec[i] )){
                         count += 1;
                         break;
@@ -523,29 +1085,13 @@ bool Linky::decData( char *dest, linky_etiq_t etiq )
     if( valid ){
         if( strcmp( this->_pDec, dest ) != 0 ){
             strcpy( dest, this->_pDec );
-            bitSet( this->_DNFR, etiq );
-    
-            if( etiq == let_ltarf ){
-                if( hchp ){
-                    this->ledOff( this->hcPin );
-                    this->ledOn( this->hpPin );
-                    if( !this->tic.hchp ){
-                        this->sendLog(( char * ) "Change to HP" );
-                    }
-                } else {
-                    this->ledOff( this->hpPin );
-                    this->ledOn( this->hcPin );
-                    if( this->tic.hchp ){
-                        this->sendLog(( char * ) "Change to HC" );
-                    }
-                }
-                this->tic.hchp = hchp;
-                bitSet( this->_DNFR, let_hchp );
-            }
+            dnfrSet( etiq );
         }
+    } else {
+        this->decError( ler_invalid, this->_startLabel, this->_pDec );
     }
 
-    return( bitRead( this->_DNFR, etiq ));
+    return( dnfrRead( etiq ));
 }
 
 bool Linky::decData( uint8_t *dest, linky_etiq_t etiq )
@@ -556,7 +1102,10 @@ bool Linky::decData( uint8_t *dest, linky_etiq_t etiq )
 
     switch( etiq ){
         case let_irms1:
-            valid = ( uint != 0 );
+            valid = isdigit( this->_pDec[0] );
+            if( valid && !this->validate( &this->stat_irms1, uint, LINKY_IRMS1_DEV )){
+                return( dnfrRead( etiq ));
+            }
             break;
 
         case let_pref:
@@ -566,16 +1115,24 @@ bool Linky::decData( uint8_t *dest, linky_etiq_t etiq )
         case let_ntarf:
             valid = ( uint > 0 );
             break;
+
+        case let_relais:
+        case let_njourf:
+        case let_njourf1:
+            valid = isdigit( this->_pDec[0] );
+            break;
     }
 
     if( valid ){
         if( uint != *dest ){
             *dest = uint;
-            bitSet( this->_DNFR, etiq );
+            dnfrSet( etiq );
         }
+    } else {
+        this->decError( ler_invalid, this->_startLabel, this->_pDec );
     }
 
-    return( bitRead( this->_DNFR, etiq ));
+    return( dnfrRead( etiq ));
 }
 
 bool Linky::decData( uint16_t *dest, linky_etiq_t etiq )
@@ -586,31 +1143,39 @@ bool Linky::decData( uint16_t *dest, linky_etiq_t etiq )
 
     switch( etiq ){
         case let_urms1:
-            if( uint > 150 ){
-                float fcent = ((( float ) uint / ( float ) *dest )) - 1.;
-                fcent = abs( fcent );
-                fcent *= 100.;
-                valid = (( uint8_t ) fcent < 25 );
+            valid = ( uint > 150 );
+            if( valid && !this->validate( &this->stat_urms1, uint, LINKY_URMS1_DEV )){
+                return( dnfrRead( etiq ));
             }
             break;
 
+        /* IRMS1 is an integer count of amps: SINSTS cannot be checked against IRMS1*URMS1 at low current */
         case let_sinsts:
-            uint16_t estim = tic.irms1 * tic.urms1;
-            float fcent = ((( float ) estim / ( float ) uint )) - 1.;
-            fcent = abs( fcent );
-            fcent *= 100.;
-            valid = (( uint8_t ) fcent < 25 );
+            valid = isdigit( this->_pDec[0] );
+            if( valid && !this->validate( &this->stat_sinsts, uint, LINKY_SINSTS_DEV )){
+                return( dnfrRead( etiq ));
+            }
+            break;
+
+        /* the injected power follows the sun, and may legitimately jump */
+        case let_sinsti:
+            valid = isdigit( this->_pDec[0] );
+            if( valid ){
+                this->producer = true;
+            }
             break;
     }
 
     if( valid ){
         if( uint != *dest ){
             *dest = uint;
-            bitSet( this->_DNFR, etiq );
+            dnfrSet( etiq );
         }
+    } else {
+        this->decError( ler_invalid, this->_startLabel, this->_pDec );
     }
 
-    return( bitRead( this->_DNFR, etiq ));
+    return( dnfrRead( etiq ));
 }
 
 bool Linky::decData( uint32_t *dest, linky_etiq_t etiq )
@@ -619,70 +1184,580 @@ bool Linky::decData( uint32_t *dest, linky_etiq_t etiq )
     this->_pDec = strtok( NULL, CLy_Sep );
     uint32_t ulong = atol( this->_pDec );
 
+    /* indexes are monotonic, and the baseline survives to a reboot (see checkpoint())
+     * a lower EAST during LINKY_REBASE_COUNT consecutive trames means that the meter has been changed:
+     * reset the baselines
+     */
     switch( etiq ){
         case let_east:
-        case let_easf01:
-        case let_easf02:
             valid = ( ulong >= *dest );
+            if( valid ){
+                this->_rebase = 0;
+                bitSet( this->_FR, lst_Idx );
+            } else if( ++this->_rebase >= LINKY_REBASE_COUNT ){
+                this->_rebase = 0;
+                memset( this->tic.index, '\0', sizeof( this->tic.index ));
+                this->tic.eait = 0;
+                memset( this->tic.erq, '\0', sizeof( this->tic.erq ));
+                this->producer = false;
+                this->energy_day[0] = '\0';
+                valid = true;
+            }
+            break;
+        default:
+            if( etiq >= let_easf01 && etiq < let_erq1+LINKY_ERQ_COUNT ){
+                valid = ( ulong >= *dest );
+            }
             break;
     }
 
     if( valid ){
         if( ulong != *dest ){
             *dest = ulong;
-            bitSet( this->_DNFR, etiq );
+            dnfrSet( etiq );
+            bitSet( this->_FR, lst_Cp );
         }
+    } else {
+        this->decError( ler_monotonic, this->_startLabel, this->_pDec );
     }
 
-    return( bitRead( this->_DNFR, etiq ));
+    return( dnfrRead( etiq ));
 }
 
 bool Linky::decData( horodate_t *dest, linky_etiq_t etiq )
 {
     _pDec = strtok( NULL, CLy_Sep );
     char *pval = strtok( NULL, CLy_Sep );
-    bool valid = this->checkHorodate( _pDec );
+    uint32_t stamp = this->checkHorodate( _pDec ) ? this->horodateStamp( _pDec ) : 0;
 
-    if( valid ){
-        if( strcmp( _pDec, dest->date ) != 0 ){
-            strncpy( dest->date, _pDec, LINKY_DATE_SIZE );
+    if( stamp ){
+        if( stamp != dest->stamp ){
+            dest->stamp = stamp;
             uint16_t ulong = atol( pval );
             dest->value = ulong;
-            bitSet( _DNFR, etiq );
+            dnfrSet( etiq );
         }
+    } else {
+        this->decError( ler_invalid, this->_startLabel, _pDec );
     }
 
-    return( bitRead( _DNFR, etiq ));
+    return( dnfrRead( etiq ));
 }
 
 /**
- * Linky::ig_checksum:
+ * Linky::decSchedule:
+ * @dest: the schedule destination member.
+ * @etiq: the exact data enum we are dealing with.
  * 
- * Checksum validation of the information group in the reception buffer.
+ * Decode a day profile, as converted by ig_receive(), into a LINKY_SCHED_SIZE schedule entries table.
+ * The whole profile is ignored if any block is invalid.
  * 
- * Returns: %TRUE if checksum is OK.
+ * Returns: %TRUE if the data has been actually updated.
  *
  * Private.
  */
-bool Linky::ig_checksum()
+bool Linky::decSchedule( uint16_t *dest, linky_etiq_t etiq )
 {
-    bool ok = true;
-    uint16_t cks = 0;
-    if( this->_iCks >= CLy_MinLg ){               /* Message is long enough */
-        for( uint8_t i=0; i<this->_iCks; i++ ){
-            cks += *(this->_pRec+i);
+    this->_pDec = strtok( NULL, CLy_Sep );
+    uint16_t sched[LINKY_SCHED_SIZE];
+    char *p = this->_pDec;
+
+    if( strlen( p ) != LINKY_SCHED_SIZE*LINKY_SCHED_CHARS ){
+        return( this->decInvalid( etiq ));
+    }
+    for( uint8_t i=0 ; i<LINKY_SCHED_SIZE ; ++i, p+=LINKY_SCHED_CHARS ){
+        sched[i] = (( uint16_t )( p[0]-'0' ) << 10 ) | (( uint16_t )( p[1]-'0' ) << 4 ) | ( p[2]-'0' );
+        if( sched[i] == LINKY_SCHED_BAD ){
+            return( this->decInvalid( etiq ));
+        }
+    }
+
+    if( memcmp( sched, dest, sizeof( sched )) != 0 ){
+        memcpy( dest, sched, sizeof( sched ));
+        dnfrSet( etiq );
+    }
+
+    return( dnfrRead( etiq ));
+}
+
+/**
+ * Linky::decError:
+ * @err: the error class.
+ * @label: the label, or the whole raw group.
+ * @value: [allow-none]: the value.
+ * 
+ * Count the error, and capture the offending group in the bad ring.
+ *
+ * Private.
+ */
+void Linky::decError( linky_error_t err, const char *label, const char *value )
+{
+    if( this->errors[err] < 0xffff ){
+        this->errors[err] += 1;
+    }
+    char *dest = this->bad[this->bad_next];
+    this->bad_next = ( this->bad_next+1 ) % LINKY_BAD_COUNT;
+
+    strncpy( dest, label ? label : "", LINKY_BAD_SIZE );
+    dest[LINKY_BAD_SIZE] = '\0';
+    uint8_t len = strlen( dest );
+    if( value && len < LINKY_BAD_SIZE-1 ){
+        dest[len] = ' ';
+        strncpy( dest+len+1, value, LINKY_BAD_SIZE-len-1 );
+    }
+}
+
+/**
+ * Linky::decInvalid:
+ * @etiq: the exact data enum we are dealing with.
+ * 
+ * Record an invalid value of the current group.
+ * 
+ * Returns: %TRUE if the data has been updated before (unchanged).
+ *
+ * Private.
+ */
+bool Linky::decInvalid( linky_etiq_t etiq )
+{
+    this->decError( ler_invalid, this->_startLabel, this->_pDec );
+    return( dnfrRead( etiq ));
+}
+
+/**
+ * Linky::decMessage:
+ * @i: 0 for MSG1, 1 for MSG2.
+ * 
+ * Keep the message, and queue it if it differs from the last sent one.
+ *
+ * Private.
+ */
+void Linky::decMessage( uint8_t i )
+{
+    this->_pDec = strtok( NULL, CLy_Sep );
+    if( !this->_pDec ){
+        return;
+    }
+
+    char *text = i ? this->msg2 : this->msg1;
+    uint8_t size = i ? LINKY_MSG2_SIZE : LINKY_MSG1_SIZE;
+    uint8_t len = strlen( this->_pDec );
+    if( len > size ){
+        len = size;
+    }
+    while( len > 0 && this->_pDec[len-1] == ' ' ){
+        --len;
+    }
+    this->_pDec[len] = '\0';
+
+    // a changed text restarts from its first chunk
+    if( strcmp( this->_pDec, text )){
+        strcpy( text, this->_pDec );
+        bitClear( this->msg_pend, i );
+    }
+    if( !bitRead( this->msg_pend, i ) && linkyHash( text ) != this->msg_hash[i] ){
+        uint8_t before = this->queueDepth( lqu_value );
+        bitSet( this->msg_pend, i );
+        bitClear( this->msg_fail, i );
+        this->msg_chunk[i] = 0;
+        this->queueAdded( lqu_value, before );
+    }
+}
+
+/**
+ * Linky::decStatus:
+ * @dest: the status register destination member.
+ * @etiq: the exact data enum we are dealing with.
+ * 
+ * Decode the 8 hex chars of the status register.
+ * The changed bits are accumulated in _stge until the next report.
+ * 
+ * Returns: %TRUE if the data has been actually updated.
+ *
+ * Private.
+ */
+bool Linky::decStatus( uint32_t *dest, linky_etiq_t etiq )
+{
+    this->_pDec = strtok( NULL, CLy_Sep );
+
+    if( strlen( this->_pDec ) != LINKY_STGE_SIZE ){
+        return( this->decInvalid( etiq ));
+    }
+    for( uint8_t i=0 ; i<LINKY_STGE_SIZE ; ++i ){
+        if( !isxdigit( this->_pDec[i] )){
+            return( this->decInvalid( etiq ));
+        }
+    }
+    uint32_t status = strtoul( this->_pDec, NULL, 16 );
+
+    if( status != *dest ){
+        uint32_t changed = status ^ *dest;
+        /* alarms are queued right away, other groups wait for the min period */
+        if( changed & LINKY_STGE_ALARM ){
+            uint8_t before = this->queueDepth( lqu_alarm );
+            this->_stge_pend |= changed & LINKY_STGE_ALARM;
+            this->queueAdded( lqu_alarm, before );
+        }
+        this->_stge |= changed & ~LINKY_STGE_ALARM;
+        *dest = status;
+        dnfrSet( etiq );
+    }
+
+    return( dnfrRead( etiq ));
+}
+
+/**
+ * Linky::diagCount:
+ * @report: the linky_diag_t report.
+ * 
+ * Returns: the count of items of the report.
+ *
+ * Private.
+ */
+uint8_t Linky::diagCount( uint8_t report )
+{
+    switch( report ){
+        case ldg_errors:
+            return( ler_count+LINKY_ICP_ITEMS+LINKY_BAD_COUNT );
+        case ldg_timing:
+            return( 4+LINKY_ICP_ITEMS );
+        case ldg_queues:
+            return( lqu_count );
+    }
+    return( 1+EEPROM_HISTOGRAM_SIZE );
+}
+
+/**
+ * Linky::diagQueue:
+ * @report: the linky_diag_t report.
+ * 
+ * Queue a diagnostic report on lqu_diag. A report already queued is sent once.
+ *
+ * Private.
+ */
+void Linky::diagQueue( uint8_t report )
+{
+    uint8_t before = this->queueDepth( lqu_diag );
+    bitSet( this->diag_pend, report );
+    this->queueAdded( lqu_diag, before );
+}
+
+/**
+ * Linky::energyBase:
+ * @period: 0 for the day, 1 for the month.
+ * @i: the accounted index, 0 for EAST, n for EASF0n.
+ * @index: the value of the index at the start of the period.
+ * 
+ * Take the snapshot of the index.
+ *
+ * Private.
+ */
+void Linky::energyBase( uint8_t period, uint8_t i, uint32_t index )
+{
+    if( period ){
+        this->energy_base[i] = index;
+    } else {
+        this->energy_day_base[i][0] = index;
+        this->energy_day_base[i][1] = index >> 8;
+        this->energy_day_base[i][2] = index >> 16;
+    }
+}
+
+/**
+ * Linky::energyClose:
+ * @month: whether the month is closed too.
+ * 
+ * Queue the increments of the closed periods whose snapshot has been taken on their boundary
+ * (see Linky.h), keeping the current indexes until they are sent.
+ *
+ * Private.
+ */
+void Linky::energyClose( bool month )
+{
+    uint8_t before = this->queueDepth( lqu_value );
+    strcpy( this->energy_closed, this->energy_day );
+    for( uint8_t i=0 ; i<LINKY_ENERGY_COUNT ; ++i ){
+        uint32_t index = this->energyIndex( i );
+        if( i && !index ){
+            continue;
+        }
+        this->energy_close[i] = index;
+        if( bitRead( this->energy_exact, 0 )){
+            bitSet( this->energy_pend, i );
+        }
+        if( month && bitRead( this->energy_exact, 1 )){
+            bitSet( this->energy_pend, 8+i );
+        }
+    }
+    this->queueAdded( lqu_value, before );
+}
+
+/**
+ * Linky::energyIndex:
+ * @i: the accounted index, 0 for EAST, n for EASF0n.
+ * 
+ * Returns: the current value of the index.
+ *
+ * Private.
+ */
+uint32_t Linky::energyIndex( uint8_t i )
+{
+    return( i ? this->tic.index[i-1] : this->tic.east );
+}
+
+/**
+ * Linky::energySince:
+ * @period: 0 for the day, 1 for the month.
+ * @i: the energy index, 0 for EAST.
+ * @index: the current value of the index.
+ * 
+ * Returns: the increment of the index since the snapshot of the period.
+ *
+ * Private.
+ */
+uint32_t Linky::energySince( uint8_t period, uint8_t i, uint32_t index )
+{
+    if( period ){
+        return( index-this->energy_base[i] );
+    }
+    const uint8_t *base = this->energy_day_base[i];
+    return(( index-( base[0] | ( uint32_t ) base[1] << 8 | ( uint32_t ) base[2] << 16 )) & 0xffffffUL );
+}
+
+/**
+ * Linky::energyUpdate:
+ * 
+ * Called on each committed trame with a validated EAST and a DATE.
+ * Close the day and the month when they change, and take the new snapshots (see Linky.h).
+ *
+ * Private.
+ */
+void Linky::energyUpdate( void )
+{
+    const char *ymd = this->tic.date+1;
+    uint32_t now = this->dateSeconds();
+    bool known = ( this->energy_day[0] != '\0' );
+    bool gap = ( this->energy_s == LINKY_POWER_NONE || ( now+86400UL-this->energy_s ) % 86400UL > LINKY_ENERGY_GAP );
+    this->energy_s = now;
+
+    /* a boundary is only handled once the increments of the previous one have been sent */
+    if( this->energy_pend || ( known && !strncmp( ymd, this->energy_day, 6 ))){
+        return;
+    }
+    bool month = !known || strncmp( ymd, this->energy_day, 4 );
+    if( known && !gap ){
+        this->energyClose( month );
+    }
 #ifdef LINKY_DEBUG
-            /*
-            Serial.print( F( "i=" ));
-            Serial.print( i );
-            Serial.print( F( ", ch=" ));
-            Serial.print( *(_pRec + i));
-            Serial.print( F( " (0x" ));
-            Serial.print( *(_pRec + i), HEX );
-            Serial.println( F( ")" ));
-            */
+    Serial.print( F( "Linky::energyUpdate() new day, month=" )); Serial.print( month );
+    Serial.print( F( ", exact=" )); Serial.println( known && !gap );
 #endif
+    /* the snapshots of the queued increments are taken when they are sent */
+    for( uint8_t i=0 ; i<LINKY_ENERGY_COUNT ; ++i ){
+        uint32_t index = this->energyIndex( i );
+        if( !bitRead( this->energy_pend, i )){
+            this->energyBase( 0, i, index );
+        }
+        if( month && !bitRead( this->energy_pend, 8+i )){
+            this->energyBase( 1, i, index );
+        }
+    }
+    bitWrite( this->energy_exact, 0, known && !gap );
+    if( month ){
+        bitWrite( this->energy_exact, 1, known && !gap );
+    }
+    strncpy( this->energy_day, ymd, 6 );
+    this->energy_day[6] = '\0';
+}
+
+/**
+ * Linky::histogramItem:
+ * @item: the item of the histogram report.
+ * 
+ * Send the sizing histogram as 'pref=kVA', then one 'from%:count' text per bucket.
+ *
+ * Returns: %TRUE.
+ *
+ * Private.
+ */
+bool Linky::histogramItem( uint8_t item )
+{
+    MyMessage msg;
+    char buffer[1+MAX_PAYLOAD];
+    sHistogram hist;
+    this->histogramTotal( hist );
+
+    if( !item ){
+        strcpy( buffer, "pref=" );
+        utoa( hist.pref, buffer+strlen( buffer ), 10 );
+    } else {
+        utoa( pgm_read_byte( &st_hist_bounds[item-1] ), buffer, 10 );
+        strcat( buffer, "%:" );
+        utoa( hist.count[item-1], buffer+strlen( buffer ), 10 );
+    }
+    msg.clear();
+    this->sendMsg( msg.setSensor( this->diag_child ).setType( V_TEXT ).set( buffer ));
+    return( true );
+}
+
+/**
+ * Linky::histogramSend:
+ * @child: the child to send the histogram on.
+ * 
+ * Queue the sizing histogram report (see histogramItem()).
+ *
+ * Public.
+ */
+void Linky::histogramSend( uint8_t child )
+{
+    this->diag_child = child;
+    this->diagQueue( ldg_histogram );
+}
+
+/**
+ * Linky::histogramUpdate:
+ * 
+ * Called on each committed trame once PREF is known.
+ * Count SINSTS in its bucket (see Linky.h).
+ *
+ * Private.
+ */
+void Linky::histogramUpdate( void )
+{
+    if( this->tic.pref != this->hist_pref ){
+        memset( this->hist_add, '\0', sizeof( this->hist_add ));
+        this->hist_pref = this->tic.pref;
+    }
+    uint32_t pref = 1000UL*this->tic.pref;
+    uint8_t b = 0;
+    for( ; b<EEPROM_HISTOGRAM_SIZE-1 ; ++b ){
+        uint32_t bound = ( b & 1 ) ? ( 181UL*pref ) >> ( 8+b/2 ) : pref >> ( b/2 );
+        if( this->tic.sinsts >= bound ){
+            break;
+        }
+    }
+    this->hist_add[b] += 1;
+}
+
+/**
+ * Linky::histogramTotal:
+ * @hist: the histogram to be filled.
+ * 
+ * Add the counts since the last write to the EEPROM histogram, which is ignored when it has been
+ * counted against another PREF. All the counts are halved when one of them would overflow.
+ *
+ * Private.
+ */
+void Linky::histogramTotal( sHistogram &hist )
+{
+    if( !eepromHistogramRead( hist, loadState ) || ( this->hist_pref && hist.pref != this->hist_pref )){
+        memset( &hist, '\0', sizeof( hist ));
+        hist.pref = this->hist_pref;
+    }
+    uint8_t shift = 0;
+    for( uint8_t i=0 ; i<EEPROM_HISTOGRAM_SIZE ; ++i ){
+        if(( uint32_t ) hist.count[i]+this->hist_add[i] > 0xffff ){
+            shift = 1;
+        }
+    }
+    for( uint8_t i=0 ; i<EEPROM_HISTOGRAM_SIZE ; ++i ){
+        hist.count[i] = (( uint32_t ) hist.count[i]+this->hist_add[i] ) >> shift;
+    }
+}
+
+/**
+ * Linky::hchpSet:
+ * @hchp: %TRUE if HP, %FALSE if HC.
+ * 
+ * Set the HC/HP LEDs, and the HCHP data.
+ *
+ * Private.
+ */
+void Linky::hchpSet( bool hchp )
+{
+    if( hchp ){
+        this->ledOff( this->hcPin );
+        this->ledOn( this->hpPin );
+        if( !this->tic.hchp ){
+            this->logQueue( llg_hp );
+        }
+    } else {
+        this->ledOff( this->hpPin );
+        this->ledOn( this->hcPin );
+        if( this->tic.hchp ){
+            this->logQueue( llg_hc );
         }
+    }
+    if( hchp != this->tic.hchp ){
+        this->tic.hchp = hchp;
+        dnfrSet( let_hchp );
+    }
+}
+
+/**
+ * Linky::horodateStamp:
+ * @p: a checked horodate, as 'SAAMMJJhhmmss'.
+ * 
+ * Pack the horodate in 32 bits, the season being ignored.
+ * 
+ * Returns: the packed horodate, which is never zero.
+ *
+ * Private.
+ */
+uint32_t Linky::horodateStamp( const char *p )
+{
+    uint32_t stamp = 0;
+    /* radix of each field: year (100), month (13), day (32), hours, minutes, seconds */
+    static const uint8_t radix[] = { 100, 13, 32, 24, 60, 60 };
+    for( uint8_t i=0 ; i<6 ; ++i ){
+        stamp = stamp*radix[i] + 10*( p[1+2*i]-'0' )+( p[2+2*i]-'0' );
+    }
+    return( stamp );
+}
+
+/**
+ * Linky::ig_block:
+ * @p: a received PJOURF+1 block, as 'HHMMSSSS' or 'NONUTILE'.
+ * 
+ * Returns: the corresponding schedule entry, or LINKY_SCHED_BAD.
+ *
+ * Private.
+ */
+uint16_t Linky::ig_block( const char *p )
+{
+    if( !strncmp_P( p, PLy_nonutile, 8 )){
+        return( LINKY_SCHED_NONE );
+    }
+    for( uint8_t c=0 ; c<8 ; ++c ){
+        if( !isxdigit( p[c] ) || ( c < 4 && !isdigit( p[c] ))){
+            return( LINKY_SCHED_BAD );
+        }
+    }
+    uint8_t hh = 10*( p[0]-'0' )+( p[1]-'0' );
+    uint8_t mm = 10*( p[2]-'0' )+( p[3]-'0' );
+    if( hh > 23 || mm > 59 ){
+        return( LINKY_SCHED_BAD );
+    }
+    uint8_t idx = isdigit( p[7] ) ? p[7]-'0' : ( p[7] | 0x20 )-'a'+10;
+    return( linkySchedEntry( 60*hh+mm, idx ));
+}
+
+/**
+ * Linky::ig_checksum:
+ * 
+ * Checksum validation of the information group in the reception buffer.
+ * 
+ * Returns: %TRUE if checksum is OK.
+ *
+ * Private.
+ */
+bool Linky::ig_checksum()
+{
+    bool ok = true;
+    uint16_t cks = 0;
+    this->cks_rate -= this->cks_rate >> 4;
+    if( this->_iCks >= CLy_MinLg ){               /* Message is long enough */
+        /* the running sum has been computed by ig_receive(), Cks included */
+        cks = ( uint8_t )( this->_sRec - *(this->_pRec+this->_iCks ));
         cks &= 0x3f;
         cks += Car_SP;
         if( cks == *(this->_pRec+this->_iCks )){        /* checksum is ok */
@@ -694,6 +1769,9 @@ bool Linky::ig_checksum()
 
         /* checksum error, cancel the received buffer */
         } else {
+            bitSet( this->_FR, lst_Err );
+            this->cks_rate += 15;
+            this->decError( ler_checksum, this->_pRec, NULL );
             Serial.print( this->_pRec );
             Serial.print( F( " checksum error: computed=0x" ));
             Serial.print( cks, HEX );
@@ -702,6 +1780,8 @@ bool Linky::ig_checksum()
             ok = false;
         }   
     } else {
+        bitSet( this->_FR, lst_Err );
+        this->decError( ler_short, this->_pRec, NULL );
         Serial.print( this->_pRec );
         Serial.println( F( " not enough received data" ));
         ok = false;
@@ -710,6 +1790,50 @@ bool Linky::ig_checksum()
     return( ok );
 }
 
+/**
+ * Linky::ig_commit:
+ * 
+ * The trame is fully received and decoded.
+ * The first trame without any error, and with a validated EAST, starts the sequence numbers and
+ * triggers the first full report.
+ *
+ * Private.
+ */
+void Linky::ig_commit()
+{
+    if( !bitRead( this->_FR, lst_Err )){
+        this->scheduleUpdate();
+        if( bitRead( this->_FR, lst_Idx )){
+            this->powerUpdate();
+            if( this->tic.date[0] ){
+                this->energyUpdate();
+            }
+        }
+        if( this->tic.date[0] ){
+            this->timingUpdate();
+        }
+        if( this->producer ){
+            this->netUpdate();
+        }
+        if( this->tic.pref && bitRead( this->_FR, lst_Val )){
+            this->histogramUpdate();
+        }
+    }
+    if( !bitRead( this->_FR, lst_Err ) && bitRead( this->_FR, lst_Idx ) && !bitRead( this->_FR, lst_Val )){
+        bitSet( this->_FR, lst_Val );
+        this->first_ms = millis();
+#ifdef LINKY_DEBUG
+        Serial.print( F( "Linky::ig_commit() first valid trame at " )); Serial.println( this->first_ms );
+#endif
+        this->seqStart( micros());
+        this->send( true );
+    }
+    if( !bitRead( this->_FR, lst_Err ) && bitRead( this->_FR, lst_Val )){
+        this->rulesApply();
+    }
+    this->seqUpdate();
+}
+
 /**
  * Linky::ig_decode:
  * 
@@ -722,8 +1846,9 @@ bool Linky::ig_checksum()
 void Linky::ig_decode()
 {
     bool found = false;
+    uint8_t idx;
     this->_pDec = strtok( _pDec, CLy_Sep );
-    //_startLabel = _pDec;
+    this->_startLabel = this->_pDec;
 
     if( !strcmp_P( this->_pDec, PLy_adsc )){
         found = true;
@@ -735,7 +1860,9 @@ void Linky::ig_decode()
 
     } else if( !strcmp_P( this->_pDec, PLy_date )){
         found = true;
-        this->decData(( char * ) this->tic.date, let_date );
+        if( this->decData(( char * ) this->tic.date, let_date )){
+            this->scheduleDay();
+        }
       
     } else if( !strcmp_P( this->_pDec, PLy_ngtf )){
         found = true;
@@ -749,13 +1876,18 @@ void Linky::ig_decode()
         found = true;
         this->decData( &this->tic.east, let_east );
 
-    } else if( !strcmp_P( this->_pDec, PLy_easf01 )){
+    } else if(( idx = this->indexFind( this->_pDec )) < LINKY_INDEX_COUNT ){
         found = true;
-        this->decData( &this->tic.easf01, let_easf01 );
-      
-    } else if( !strcmp_P( this->_pDec, PLy_easf02 )){
+        this->decData( &this->tic.index[idx], ( linky_etiq_t )( let_easf01+idx ));
+
+    } else if( !strcmp_P( this->_pDec, PLy_eait )){
+        found = true;
+        this->decData( &this->tic.eait, let_eait );
+
+    } else if( !strncmp_P( this->_pDec, PLy_erq, 3 ) && this->_pDec[3] >= '1' && this->_pDec[3] < '1'+LINKY_ERQ_COUNT && !this->_pDec[4] ){
         found = true;
-        this->decData( &this->tic.easf02, let_easf02 );
+        idx = this->_pDec[3]-'1';
+        this->decData( &this->tic.erq[idx], ( linky_etiq_t )( let_erq1+idx ));
       
     } else if( !strcmp_P( this->_pDec, PLy_irms1 )){
         found = true;
@@ -781,7 +1913,19 @@ void Linky::ig_decode()
         found = true;
         this->decData( &this->tic.smaxsnm1, let_smaxsnm1 );
       
-    } else if( !strcmp_P( this->_pDec, PLy_ccasn )){
+    } else if( !strcmp_P( this->_pDec, PLy_sinsti )){
+        found = true;
+        this->decData( &this->tic.sinsti, let_sinsti );
+      
+    } else if( !strcmp_P( this->_pDec, PLy_smaxin )){
+        found = true;
+        this->decData( &this->tic.smaxin, let_smaxin );
+      
+    } else if( !strcmp_P( this->_pDec, PLy_smaxinm1 )){
+        found = true;
+        this->decData( &this->tic.smaxinm1, let_smaxinm1 );
+      
+    } else if( !strcmp_P( this->_pDec, PLy_ccasn )){
         found = true;
         this->decData( &this->tic.ccasn, let_ccasn );
       
@@ -789,181 +1933,1405 @@ void Linky::ig_decode()
         found = true;
         this->decData( &this->tic.ccasnm1, let_ccasnm1 );
       
+    } else if( !strcmp_P( this->_pDec, PLy_ccain )){
+        found = true;
+        this->decData( &this->tic.ccain, let_ccain );
+      
+    } else if( !strcmp_P( this->_pDec, PLy_ccainm1 )){
+        found = true;
+        this->decData( &this->tic.ccainm1, let_ccainm1 );
+      
     } else if( !strcmp_P( this->_pDec, PLy_umoy1 )){
         found = true;
         this->decData( &this->tic.umoy1, let_umoy1 );
 
-    } else if( !strcmp_P( this->_pDec, PLy_stge )){
-        found = true;
-        this->decData(( char * ) this->tic.stge, let_stge );
+    } else if( !strcmp_P( this->_pDec, PLy_stge )){
+        found = true;
+        this->decStatus( &this->tic.stge, let_stge );
+
+    } else if( !strcmp_P( this->_pDec, PLy_msg1 )){
+        found = true;
+        this->decMessage( 0 );
+
+    } else if( !strcmp_P( this->_pDec, PLy_msg2 )){
+        found = true;
+        this->decMessage( 1 );
+
+    } else if( !strcmp_P( this->_pDec, PLy_prm )){
+        found = true;
+        this->decData(( char * ) this->tic.prm, let_prm );
+      
+    } else if( !strcmp_P( this->_pDec, PLy_relais )){
+        found = true;
+        this->decData( &this->tic.relais, let_relais );
+      
+    } else if( !strcmp_P( this->_pDec, PLy_ntarf )){
+        found = true;
+        this->decData( &this->tic.ntarf, let_ntarf );
+
+    } else if( !strcmp_P( this->_pDec, PLy_njourf )){
+        found = true;
+        this->decData( &this->tic.njourf, let_njourf );
+
+    } else if( !strcmp_P( this->_pDec, PLy_njourf1 )){
+        found = true;
+        this->decData( &this->tic.njourf1, let_njourf1 );
+
+    } else if( !strcmp_P( this->_pDec, PLy_pjourf1 )){
+        found = true;
+        this->decSchedule( this->tic.pjourf1, let_pjourf1 );
+
+    } else if( this->logIgnoredGet()){
+        this->logIgnored();
+    }
+
+#ifdef LINKY_DEBUG
+    if( !found ){
+        Serial.print( F( " ignored" ));
+    } else {
+        Serial.print( F( " ok" ));
+    }
+#endif
+}
+
+/**
+ * Linky::ig_process:
+ * 
+ * Decode the received information group, commit the trame, and receive the next characters.
+ *
+ * Private.
+ */
+void Linky::ig_process()
+{
+    /* 1st part, last action : decode information */
+    if( bitRead( this->_FR, lst_Dec )){
+        bitClear( this->_FR, lst_Dec );
+#ifdef LINKY_DEBUG
+        Serial.print( this->_pDec );
+#endif
+        this->ig_decode();
+#ifdef LINKY_DEBUG
+        Serial.println();
+#endif
+    }
+    /* 2nd part, commit the trame when all its groups have been decoded */
+    if( bitRead( this->_FR, lst_Etx ) && !bitRead( this->_FR, lst_Dec )){
+        bitClear( this->_FR, lst_Etx );
+        this->ig_commit();
+    }
+    /* 3rd part, receiver processing - always run */
+    this->ig_receive();
+}
+
+/**
+ * Linky::ig_receive:
+ * 
+ * Get the new information group from the serial input,
+ *  and stores it in the current _pRec reception buffer.
+ *  Validates the checksum.
+ *  Switch the reception buffer ater checksum validation.
+ *  
+ * The method exits either at end of information group (and checksum valide), or if
+ * there is no more available character in the serial input.
+ * Returning as soon as a group is handed to the decoder guarantees that the buffer A is free again
+ * when the next group is received, so that a long group may always be moved there.
+ *
+ * Private.
+ */
+void Linky::ig_receive()
+{
+    while( this->linkySerial.available()){                   /* At least 1 char has been received */
+        char c = this->linkySerial.read() & 0x7f;            /* Read char, drop the parity bit (only checked by icpSerial) */
+#ifdef LINKY_CAPTURE
+        this->capture( c );
+#endif
+#ifdef LINKY_DEBUG
+        //Serial.print( F( "Serial.read() c=" )); Serial.println( c, HEX );
+#endif
+        /* On going reception */
+        if( bitRead( this->_FR, lst_Rec )){
+            /* Received end of information group char, aka CR, aka \r, aka 0x0D */
+            if( c == Car_EOIG ){   
+                bitClear( this->_FR, lst_Rec );       /* Receiving complete */
+                this->_iCks = this->_iRec-1;                /* Index of Cks in the message */
+                *(this->_pRec+this->_iRec) = '\0';          /* Terminate the string */
+#ifdef LINKY_DEBUG
+                //Serial.print( F( "Found EOIG=" ));
+                //Serial.println( _pRec );
+#endif
+                /* if checksum is OK, swap the buffers and decode the group */
+                if( this->ig_checksum()){
+                    bitSet( this->_FR, lst_Dec );         /* Next step, decoding group information */
+                    /* Swap reception and decode buffers */
+                    if( bitRead( this->_FR, lst_RxB )){   /* Receiving in B, Decode in A, swap */
+                        bitClear( this->_FR, lst_RxB );
+                        this->_pRec = this->_BfA;               /* --> Receive in A */
+                        this->_pDec = this->_BfB;               /* --> Decode in B */
+#ifdef LINKY_DEBUG
+                        //Serial.println( F( "receive() set _pRec=_BfA, _pDec=_BfB" ));
+#endif
+                    } else {                        /* Receiving in A, Decode in B, swap */
+                        bitSet( this->_FR, lst_RxB );
+                        this->_pRec = this->_BfB;               /* --> Receive in B */
+                        this->_pDec = this->_BfA;               /* --> Decode in A */
+#ifdef LINKY_DEBUG
+                        //Serial.println( F( "receive() set _pRec=_BfB, _pDec=_BfA" ));
+#endif
+                    }
+                    /* let loop() decode the group before receiving the next one */
+                    return;
+                /* if checksum is not ok, keep the same buffer */
+                } else {
+                    this->_iRec = 0;
+                }
+
+            /* Other character during information group reception */
+            } else {
+                this->_sRec += c;
+                if( this->_iBlk ){                          /* Receiving the PJOURF+1 blocks */
+                    if( c == Car_SP && this->_iRec == this->_iBlk ){
+                        continue;                           /* the separator of two converted blocks */
+                    }
+                    if( c == Car_HT ){
+                        this->_iBlk = 0;                    /* end of the value */
+                    }
+                }
+                *(this->_pRec+this->_iRec) = c;             /* Store received character */
+                this->_iRec += 1;
+                /* convert each complete PJOURF+1 block to its schedule entry */
+                if( this->_iBlk ){
+                    if( this->_iRec-this->_iBlk == 8 ){
+                        uint16_t entry = this->ig_block( this->_pRec+this->_iBlk );
+                        *(this->_pRec+this->_iBlk) = '0'+( entry >> 10 );
+                        *(this->_pRec+this->_iBlk+1) = '0'+(( entry >> 4 ) & 0x3f );
+                        *(this->_pRec+this->_iBlk+2) = '0'+( entry & 0x0f );
+                        this->_iBlk += LINKY_SCHED_CHARS;
+                        this->_iRec = this->_iBlk;
+                    }
+                } else if( c == Car_HT && this->_iRec == 9 && !strncmp_P( this->_pRec, PLy_pjourf1, 8 )){
+                    this->_iBlk = this->_iRec;
+                }
+                if( this->_iRec >= LINKY_BUFSIZE-1 ){       /* Buffer overflow */
+                    bitClear( this->_FR, lst_Rec );         /* Stop reception and do nothing */
+                    bitSet( this->_FR, lst_Err );
+                    *(this->_pRec+LINKY_BUFSIZE-1) = '\0';
+                    this->decError( ler_overflow, this->_pRec, NULL );
+                    Serial.print( this->_pRec );
+                    Serial.print( F( " buffer overflow (" ));
+                    Serial.print( LINKY_BUFSIZE );
+                    Serial.println( F( " bytes)" ));
+                }
+            }
+
+        /* Reception not yet started, trying to start it 
+            At startup, wait until we have catch the start of the trame */
+        } else if( this->stx_ms > 0 && c == Car_SOIG ){   /* Received start of information group */
+            this->_iRec = 0;
+            this->_sRec = 0;
+            this->_iBlk = 0;
+            bitSet( this->_FR, lst_Rec );             /* Start reception */
+#ifdef LINKY_DEBUG
+            //Serial.println( F( "received SOIG" ));
+#endif
+
+        /* start of trame */
+        } else if( c == Car_STX ){
+            uint32_t now = millis();
+            if( this->stx_ms > 0 ){
+                uint32_t ifi = now - this->stx_ms;
+                uint16_t ms = ifi > 0xffff ? 0xffff : ifi;
+                this->ifi_avg = this->ifi_avg ? this->ifi_avg - ( this->ifi_avg >> 3 ) + ( ms >> 3 ) : ms;
+                if( ms > this->ifi_max ){
+                    this->ifi_max = ms;
+                }
+            }
+            this->stx_ms = now;
+            bitClear( this->_FR, lst_Err );
+            bitClear( this->_FR, lst_Idx );
+            this->ltarf_hp = -1;
+#ifdef LINKY_DEBUG
+            //Serial.println( F( "received STX" ));
+#endif
+
+        /* if end of trame 
+            we assume that we get one trame every sec. at 9600 bauds
+            As of 2025-10- 1 (v4.0-2025) delay=1697 */
+        } else if( c == Car_ETX ){
+            uint32_t now = millis();
+            uint32_t delay = now - this->stx_ms;
+#ifdef LINKY_DEBUG
+            Serial.print( F( "received ETX, delay=" ));
+            Serial.println( delay );
+#endif
+            this->trameLedSet( delay < 2000 ? TRAMEOK_MS : TRAMENOTOK_MS );
+            if( this->stx_ms > 0 ){
+                bitSet( this->_FR, lst_Etx );
+                uint16_t ms = delay > 0xffff ? 0xffff : delay;
+                this->dur_avg = this->dur_avg ? this->dur_avg - ( this->dur_avg >> 3 ) + ( ms >> 3 ) : ms;
+                if( ms > this->dur_max ){
+                    this->dur_max = ms;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Linky::logIgnored:
+ * 
+ * Duplicate the trames reception to the output thread is asked for.
+ * A buffer is built with trimmed label and values, '|'-separated.
+ * The label is only reported if it is new, if its value has changed, or after LINKY_IGNORED_REFRESH.
+ *
+ * Private.
+ */
+void Linky::logIgnored()
+{
+    char *label = this->_pDec;
+    char *p = strtok( NULL, CLy_Sep );
+    uint16_t lh = linkyHash( label );
+    uint16_t vh = p ? linkyHash( p ) : 0;
+    uint16_t now = millis() / 60000;
+    linky_ignored_t *entry = NULL;
+
+    // find the label in the inventory, or a free entry
+    uint8_t slot = lh % LINKY_IGNORED_SIZE;
+    for( uint8_t i=0 ; i<LINKY_IGNORED_SIZE ; ++i, slot=( slot+1 ) % LINKY_IGNORED_SIZE ){
+        if( this->ignored[slot].label == lh ){
+            entry = &this->ignored[slot];
+            if( entry->value == vh && ( uint16_t )( now - entry->sent ) < LINKY_IGNORED_REFRESH ){
+                return;
+            }
+            break;
+        }
+        if( !this->ignored[slot].label ){
+            entry = &this->ignored[slot];
+            entry->label = lh;
+            break;
+        }
+    }
+    if( !entry ){
+        return;
+    }
+    /* lowest priority, single slot: the label will be seen again with a next trame */
+    if( !this->queuesEmpty()){
+        if( this->q_depth[lqu_log] < 0xff ){
+            this->q_depth[lqu_log] += 1;
+        }
+        return;
+    }
+    entry->value = vh;
+    entry->sent = now;
+
+    char *buffer = this->log_text;   // MySensors max payload is 25 bytes
+    memset( buffer, '\0', sizeof( this->log_text ));
+
+    // prefix
+    strcpy( buffer, "[I]: " );
+    uint8_t len = strlen( buffer );
+
+    // label
+    strncat( buffer, label, MAX_PAYLOAD-len );
+    len = strlen( buffer );
+
+    // value
+    if( p && p[0] && len<MAX_PAYLOAD-1 ){
+        buffer[len] = '|';
+        len += 1;
+        String str = p;
+        str.trim();
+        strncat( buffer, str.c_str(), MAX_PAYLOAD-len );
+    }
+}
+
+/**
+ * Linky::logQueue:
+ * @log: the linky_log_t log.
+ * 
+ * Queue a fixed text log on lqu_value, in place of its pending opposite one.
+ *
+ * Private.
+ */
+void Linky::logQueue( uint8_t log )
+{
+    uint8_t before = this->queueDepth( lqu_value );
+    bitClear( this->log_pend, log ^ 1 );
+    bitSet( this->log_pend, log );
+    this->queueAdded( lqu_value, before );
+}
+
+/**
+ * Linky::netUpdate:
+ * 
+ * Called on each committed trame of a producer meter.
+ * Update the net apparent power, negative while injecting.
+ *
+ * Private.
+ */
+void Linky::netUpdate( void )
+{
+    int32_t net = ( int32_t ) this->tic.sinsts - ( int32_t ) this->tic.sinsti;
+    if( net > INT16_MAX ){
+        net = INT16_MAX;
+    } else if( net < INT16_MIN ){
+        net = INT16_MIN;
+    }
+    if( net != this->tic.net ){
+        this->tic.net = net;
+        dnfrSet( let_net );
+    }
+}
+
+/**
+ * Linky::pace:
+ * 
+ * Adapt the min period to the outcome of the messages sent since the previous send() round (AIMD):
+ * - if some message has not reached the gateway, the period is doubled, up to the max period
+ * - if all messages went through, the period is decreased by one configured min period, down to it.
+ *
+ * Private.
+ */
+void Linky::pace( void )
+{
+    uint32_t cur = this->min_period.getDelay();
+    uint32_t next = cur;
+    uint32_t max = this->max_period.getDelay();
+
+    if( this->_fails ){
+        next = ( cur > max/2 ) ? max : 2*cur;
+    } else if( this->_sent ){
+        next = ( cur > 2*this->min_period_ms ) ? cur - this->min_period_ms : this->min_period_ms;
+    }
+    if( next != cur ){
+#ifdef LINKY_DEBUG
+        Serial.print( F( "Linky::pace() min_period=" )); Serial.print( next );
+        Serial.print( F( ", wait=" )); Serial.println( this->pace_ms );
+#endif
+        this->min_period.setDelay( next );
+    }
+}
+
+/**
+ * Linky::queueAdded:
+ * @queue: the linky_queue_t queue.
+ * @before: the count of pending items before the enqueue.
+ * 
+ * Record the enqueue time when the queue was empty, and the max count of pending items.
+ *
+ * Private.
+ */
+void Linky::queueAdded( uint8_t queue, uint8_t before )
+{
+    if( !before ){
+        this->q_since[queue] = millis();
+    }
+    uint8_t depth = this->queueDepth( queue );
+    if( depth > this->q_depth[queue] ){
+        this->q_depth[queue] = depth;
+    }
+}
+
+/**
+ * Linky::queueDepth:
+ * @queue: the linky_queue_t queue.
+ * 
+ * Returns: the count of pending items in the queue.
+ *
+ * Private.
+ */
+uint8_t Linky::queueDepth( uint8_t queue )
+{
+    uint8_t count = 0;
+
+    switch( queue ){
+        case lqu_alarm:
+        case lqu_value:
+            for( uint8_t i=0 ; i<LINKY_STGE_COUNT ; ++i ){
+                uint32_t mask = linkyStgeMask( i );
+                if(( this->_stge_pend & mask ) && ( queue == lqu_alarm ) == (( mask & LINKY_STGE_ALARM ) != 0 )){
+                    count += 1;
+                }
+            }
+            if( queue == lqu_value ){
+                for( uint8_t i=0 ; i<let_count ; ++i ){
+                    if( pendRead( i )){
+                        count += 1;
+                    }
+                }
+                count += bitRead( this->msg_pend, 0 )+bitRead( this->msg_pend, 1 );
+                for( uint8_t i=0 ; i<llg_count ; ++i ){
+                    count += bitRead( this->log_pend, i );
+                }
+                for( uint8_t n=0 ; n<16 ; ++n ){
+                    count += bitRead( this->energy_pend, n );
+                }
+                count += this->seq_pend;
+            }
+            break;
+        case lqu_dump:
+            if( this->dump_next != LINKY_DUMP_NONE ){
+                count = LINKY_DUMP_COUNT-this->dump_next;
+            }
+            break;
+        case lqu_diag:
+            for( uint8_t i=0 ; i<ldg_count ; ++i ){
+                if( bitRead( this->diag_pend, i )){
+                    count += this->diagCount( i );
+                }
+            }
+            if( this->diag_cur != ldg_count ){
+                count -= this->diag_next;
+            }
+            break;
+        case lqu_log:
+            count = this->log_text[0] ? 1 : 0;
+            break;
+    }
+    return( count );
+}
+
+/**
+ * Linky::queueSent:
+ * @queue: the linky_queue_t queue.
+ * 
+ * Account a message sent from the queue, and its latency since the enqueue.
+ *
+ * Private.
+ */
+void Linky::queueSent( uint8_t queue )
+{
+    this->q_sent[queue] += 1;
+    uint32_t lat = millis()-this->q_since[queue];
+    if( lat > 0xffff ){
+        lat = 0xffff;
+    }
+    if( lat > this->q_lat[queue] ){
+        this->q_lat[queue] = lat;
+    }
+}
+
+/**
+ * Linky::queuesEmpty:
+ * 
+ * Returns: %TRUE if there is nothing to be sent.
+ *
+ * Private.
+ */
+bool Linky::queuesEmpty( void )
+{
+    if( this->_stge_pend || this->msg_pend || this->log_pend || this->energy_pend || this->seq_pend || this->dump_next != LINKY_DUMP_NONE ||
+            this->diag_pend || this->log_text[0] ){
+        return( false );
+    }
+    for( uint8_t i=0 ; i<sizeof( this->_PEND ) ; ++i ){
+        if( this->_PEND[i] ){
+            return( false );
+        }
+    }
+    return( true );
+}
+
+/**
+ * Linky::dateSeconds:
+ * 
+ * Returns: the second of the day of the last DATE.
+ *
+ * Private.
+ */
+uint32_t Linky::dateSeconds( void )
+{
+    const char *date = this->tic.date;
+    return( 3600UL*( 10*( date[7]-'0' )+( date[8]-'0' ))
+            + 60*( 10*( date[9]-'0' )+( date[10]-'0' ))
+            + 10*( date[11]-'0' )+( date[12]-'0' ));
+}
+
+/**
+ * Linky::powerUpdate:
+ * 
+ * Called on each committed trame with a validated EAST.
+ * Derive the active power from the EAST increments (see Linky.h).
+ * The first increment after startup (or after a resync) only sets the time origin, and the average is
+ * seeded with the first sample.
+ *
+ * Private.
+ */
+void Linky::powerUpdate( void )
+{
+    if( !this->tic.date[0] ){
+        return;
+    }
+    uint32_t now = this->dateSeconds();
+    uint32_t east = this->tic.east;
+    uint32_t elapsed = ( now+86400UL-this->power_s ) % 86400UL;
+
+    if( east != this->power_east ){
+        if( this->power_s != LINKY_POWER_NONE && east > this->power_east && elapsed > 0 && elapsed <= LINKY_POWER_MAX_S ){
+            uint32_t sample = 3600UL*( east-this->power_east )/elapsed;
+            if( sample > 0xffff ){
+                sample = 0xffff;
+            }
+            // the average starts from the first sample, not from zero
+            if( this->power_acc == LINKY_POWER_NONE ){
+                this->power_acc = sample << LINKY_POWER_SHIFT;
+            } else {
+                this->power_acc += sample - ( this->power_acc >> LINKY_POWER_SHIFT );
+            }
+        } else if( this->power_east && east < this->power_east ){
+            // meter change: wait for the next increment
+            now = LINKY_POWER_NONE;
+        }
+        this->power_s = this->power_east ? now : LINKY_POWER_NONE;
+        this->power_east = east;
+
+    } else if( this->power_acc != LINKY_POWER_NONE && this->power_s != LINKY_POWER_NONE && elapsed > 0 && elapsed <= LINKY_POWER_MAX_S ){
+        uint32_t bound = 3600UL/elapsed;
+        if(( this->power_acc >> LINKY_POWER_SHIFT ) > bound ){
+            this->power_acc = bound << LINKY_POWER_SHIFT;
+        }
+    }
+
+    // nothing to report until the first sample
+    if( this->power_acc == LINKY_POWER_NONE ){
+        return;
+    }
+    uint32_t power = this->power_acc >> LINKY_POWER_SHIFT;
+    if( power > 0xffff ){
+        power = 0xffff;
+    }
+    if( power != this->tic.power ){
+        this->tic.power = power;
+        dnfrSet( let_power );
+    }
+}
+
+/**
+ * Linky::rulesApply:
+ * 
+ * Evaluate the load shedding rules against the committed trame, and drive their pins.
+ * Only integer operations: SINSTS (VA) is compared to arg % of PREF (kVA) as 100*SINSTS > 1000*arg*PREF.
+ *
+ * Private.
+ */
+void Linky::rulesApply( void )
+{
+    for( uint8_t i=0 ; i<EEPROM_RULES ; ++i ){
+        const sRule *rule = &this->rules[i];
+        bool on = bitRead( this->rules_on, i );
+        bool want = on;
+
+        if( !rule->pin ){
+            continue;
+        }
+        switch( rule->type ){
+            case RULE_OVERLOAD:
+                if( this->tic.pref ){
+                    bool over = ( 100UL * this->tic.sinsts > 1000UL * rule->arg * this->tic.pref );
+                    if( over == on ){
+                        this->rules_count[i] = 0;
+                    } else if( ++this->rules_count[i] >= rule->frames ){
+                        this->rules_count[i] = 0;
+                        want = over;
+                    }
+                }
+                break;
+            case RULE_RELAIS:
+                want = bitRead( this->tic.relais, rule->arg & 0x07 );
+                break;
+            case RULE_SURPLUS:
+                {
+                    bool over = ( -( int32_t ) this->tic.net > 100L * rule->arg );
+                    if( over == on ){
+                        this->rules_count[i] = 0;
+                    } else if( ++this->rules_count[i] >= rule->frames ){
+                        this->rules_count[i] = 0;
+                        want = over;
+                    }
+                }
+                break;
+        }
+        if( want != on ){
+            bitWrite( this->rules_on, i, want );
+            if( want ){
+                this->ledOn( rule->pin );
+                this->logQueue( llg_shed_on );
+            } else {
+                this->ledOff( rule->pin );
+                this->logQueue( llg_shed_off );
+            }
+        }
+    }
+}
+
+/**
+ * Linky::seqStart:
+ * @seq: the new sequence number.
+ * 
+ * (Re)start the sequence numbers, all the fields being marked as old.
+ *
+ * Private.
+ */
+void Linky::seqStart( uint16_t seq )
+{
+    this->seq = seq;
+    this->seq_count = 0;
+    /* a queued number would belong to the previous sequence */
+    this->seq_ack = seq;
+    uint8_t old = ( seqEpoch( seq+1 )-LINKY_SEQ_OLD ) & 0x0f;
+    memset( this->chg_epoch, old | ( old << 4 ), sizeof( this->chg_epoch ));
+}
+
+/**
+ * Linky::seqUpdate:
+ * 
+ * Called on each committed trame.
+ * Increment the sequence number, and mark one field as old when its last change is out of the window,
+ * so that its epoch never wraps.
+ *
+ * Private.
+ */
+void Linky::seqUpdate( void )
+{
+    this->seq += 1;
+    if( this->seq_count < LINKY_SEQ_WINDOW ){
+        this->seq_count += 1;
+    }
+    uint8_t epoch = seqEpoch( this->seq+1 );
+    uint8_t i = this->seq % let_count;
+    if( epochAge( epoch, i ) > LINKY_SEQ_OLD ){
+        epochWrite( i, epoch-LINKY_SEQ_OLD );
+    }
+}
+
+/**
+ * Linky::sendDiag:
+ * 
+ * Send the next item of the queued diagnostic reports, one report after the other, or else the queued
+ * ignored label log.
+ *
+ * Private.
+ */
+void Linky::sendDiag( void )
+{
+    while( this->diag_pend ){
+        if( this->diag_cur == ldg_count ){
+            for( this->diag_cur=0 ; !bitRead( this->diag_pend, this->diag_cur ) ; ++this->diag_cur );
+            this->diag_next = 0;
+        }
+        uint8_t item = this->diag_next++;
+        bool sent = false;
+        if( item < this->diagCount( this->diag_cur )){
+            switch( this->diag_cur ){
+                case ldg_errors:
+                    sent = this->errorsItem( item );
+                    break;
+                case ldg_timing:
+                    sent = this->timingItem( item );
+                    break;
+                case ldg_queues:
+                    sent = this->queuesItem( item );
+                    break;
+                case ldg_histogram:
+                    sent = this->histogramItem( item );
+                    break;
+            }
+        } else {
+            bitClear( this->diag_pend, this->diag_cur );
+            this->diag_cur = ldg_count;
+        }
+        if( sent ){
+            this->queueSent( lqu_diag );
+            return;
+        }
+    }
+    if( this->log_text[0] ){
+        this->sendLog( this->log_text );
+        this->log_text[0] = '\0';
+        this->q_sent[lqu_log] += 1;
+    }
+}
+
+/**
+ * Linky::sendClosed:
+ * @n: the queued increment, as 8*period+i.
+ * 
+ * Send the increment of the index i over the closed period, and take the snapshot of the new period.
+ *
+ * Private.
+ */
+void Linky::sendClosed( uint8_t n )
+{
+    MyMessage msg;
+    char buffer[1+MAX_PAYLOAD];
+    uint8_t period = n >> 3;
+    uint8_t i = n & 7;
+    uint8_t len = period ? 4 : 6;
+
+    strncpy( buffer, this->energy_closed, len );
+    buffer[len] = ' ';
+    if( i ){
+        buffer[len+1] = '0'+i/10;
+        buffer[len+2] = '0'+i%10;
+        buffer[len+3] = '\0';
+    } else {
+        buffer[len+1] = 'T';
+        buffer[len+2] = '\0';
+    }
+    strcat( buffer, "=" );
+    ultoa( this->energySince( period, i, this->energy_close[i] ), buffer+strlen( buffer ), 10 );
+    bitClear( this->energy_pend, n );
+    this->energyBase( period, i, this->energy_close[i] );
+    msg.clear();
+    this->sendMsg( msg.setSensor( period ? CHILD_ID_ENERGY_MONTH_CLOSED : CHILD_ID_ENERGY_DAY_CLOSED ).setType( V_TEXT ).set( buffer ));
+}
+
+/**
+ * Linky::sendEnergy:
+ * @i: 0 for the running increment of the day, 1 for the one of the month.
+ * 
+ * Returns: %TRUE if a message has been sent.
+ *
+ * Private.
+ */
+bool Linky::sendEnergy( uint8_t i )
+{
+    if( !this->energy_day[0] ){
+        return( false );
+    }
+    /* the snapshot of a period whose close is still queued is the index at the boundary */
+    uint32_t since = bitRead( this->energy_pend, 8*i ) ? this->tic.east-this->energy_close[0] : this->energySince( i, 0, this->tic.east );
+    MyMessage msg;
+    msg.clear();
+    this->sendMsg( msg.setSensor( i ? CHILD_ID_ENERGY_MONTH : CHILD_ID_ENERGY_TODAY ).setType( V_KWH ).set( since / 1000.0, 3 ));
+    return( true );
+}
+
+/**
+ * Linky::sendEtiq:
+ * @etiq: the linky_etiq_t field.
+ * @all: whether the field is sent as part of a full report.
+ * 
+ * Send the value of a field.
+ * In a full report, the unused indexes and the producer groups which are not sent by the meter are
+ * skipped.
+ *
+ * Returns: %TRUE if a message has been sent.
+ *
+ * Private.
+ */
+bool Linky::sendEtiq( uint8_t etiq, bool all )
+{
+    MyMessage msg;
+    msg.clear();
+
+    /* unused indexes stay at zero and are never reported */
+    if( etiq >= let_easf01 && etiq < let_easf01+LINKY_INDEX_COUNT ){
+        uint8_t i = etiq-let_easf01;
+        if( all && !this->tic.index[i] ){
+            return( false );
+        }
+        this->sendMsg( msg.setSensor( CHILD_ID_EASF01+i ).setType( V_KWH ).set( this->tic.index[i] / 1000.0, 3 ));
+        return( true );
+    }
+    /* injection groups are only sent by producer meters */
+    if( etiq >= let_erq1 && etiq < let_erq1+LINKY_ERQ_COUNT ){
+        uint8_t i = etiq-let_erq1;
+        if( all && !this->tic.erq[i] ){
+            return( false );
+        }
+        this->sendMsg( msg.setSensor( CHILD_ID_ERQ1+i ).setType( V_KWH ).set( this->tic.erq[i] / 1000.0, 3 ));
+        return( true );
+    }
+    if( all ){
+        switch( etiq ){
+            case let_eait:
+            case let_sinsti:
+            case let_net:
+                if( !this->producer ){
+                    return( false );
+                }
+                break;
+            case let_power:
+                if( this->power_acc == LINKY_POWER_NONE ){
+                    return( false );
+                }
+                break;
+            case let_smaxin:
+                if( !this->tic.smaxin.stamp ){
+                    return( false );
+                }
+                break;
+            case let_smaxinm1:
+                if( !this->tic.smaxinm1.stamp ){
+                    return( false );
+                }
+                break;
+            case let_ccain:
+                if( !this->tic.ccain.stamp ){
+                    return( false );
+                }
+                break;
+            case let_ccainm1:
+                if( !this->tic.ccainm1.stamp ){
+                    return( false );
+                }
+                break;
+        }
+    }
+    switch( etiq ){
+        case let_adsc:
+            msg.setSensor( CHILD_ID_ADSC ).setType( V_TEXT ).set( this->tic.adsc );
+            break;
+        case let_vtic:
+            msg.setSensor( CHILD_ID_VTIC ).setType( V_TEXT ).set( this->tic.vtic );
+            break;
+        case let_date:
+            msg.setSensor( CHILD_ID_DATE ).setType( V_TEXT ).set( this->tic.date );
+            break;
+        case let_ngtf:
+            msg.setSensor( CHILD_ID_NGTF ).setType( V_TEXT ).set( this->tic.ngtf );
+            break;
+        case let_ltarf:
+            msg.setSensor( CHILD_ID_LTARF ).setType( V_TEXT ).set( this->tic.ltarf );
+            break;
+        case let_east:
+            msg.setSensor( CHILD_ID_EAST ).setType( V_KWH ).set( this->tic.east / 1000.0, 3 );
+            break;
+        case let_eait:
+            msg.setSensor( CHILD_ID_EAIT ).setType( V_KWH ).set( this->tic.eait / 1000.0, 3 );
+            break;
+        case let_irms1:
+            msg.setSensor( CHILD_ID_IRMS1 ).setType( V_CURRENT ).set( this->tic.irms1 );
+            break;
+        case let_urms1:
+            msg.setSensor( CHILD_ID_URMS1 ).setType( V_VOLTAGE ).set( this->tic.urms1 );
+            break;
+        case let_pref:
+            msg.setSensor( CHILD_ID_PREF ).setType( V_VA ).set( this->tic.pref * 1000 );
+            break;
+        case let_sinsts:
+            msg.setSensor( CHILD_ID_SINSTS ).setType( V_VA ).set( this->tic.sinsts );
+            break;
+        case let_smaxsn:
+            msg.setSensor( CHILD_ID_SMAXSN ).setType( V_VA ).set( this->tic.smaxsn.value );
+            break;
+        case let_smaxsnm1:
+            msg.setSensor( CHILD_ID_SMAXSN_1 ).setType( V_VA ).set( this->tic.smaxsnm1.value );
+            break;
+        case let_sinsti:
+            msg.setSensor( CHILD_ID_SINSTI ).setType( V_VA ).set( this->tic.sinsti );
+            break;
+        case let_smaxin:
+            msg.setSensor( CHILD_ID_SMAXIN ).setType( V_VA ).set( this->tic.smaxin.value );
+            break;
+        case let_smaxinm1:
+            msg.setSensor( CHILD_ID_SMAXIN_1 ).setType( V_VA ).set( this->tic.smaxinm1.value );
+            break;
+        case let_ccasn:
+            msg.setSensor( CHILD_ID_CCASN ).setType( V_WATT ).set( this->tic.ccasn.value );
+            break;
+        case let_ccasnm1:
+            msg.setSensor( CHILD_ID_CCASN_1 ).setType( V_WATT ).set( this->tic.ccasnm1.value );
+            break;
+        case let_ccain:
+            msg.setSensor( CHILD_ID_CCAIN ).setType( V_WATT ).set( this->tic.ccain.value );
+            break;
+        case let_ccainm1:
+            msg.setSensor( CHILD_ID_CCAIN_1 ).setType( V_WATT ).set( this->tic.ccainm1.value );
+            break;
+        case let_umoy1:
+            msg.setSensor( CHILD_ID_UMOY1 ).setType( V_VOLTAGE ).set( this->tic.umoy1.value );
+            break;
+        case let_stge: {
+            char stge[1+LINKY_STGE_SIZE];
+            for( int8_t i=LINKY_STGE_SIZE-1 ; i>=0 ; --i ){
+                uint8_t nibble = ( this->tic.stge >> ( 4*( LINKY_STGE_SIZE-1-i ))) & 0x0f;
+                stge[i] = nibble < 10 ? '0'+nibble : 'A'+nibble-10;
+            }
+            stge[LINKY_STGE_SIZE] = '\0';
+            msg.setSensor( CHILD_ID_STGE ).setType( V_TEXT ).set( stge );
+            break;
+        }
+        case let_prm:
+            msg.setSensor( CHILD_ID_PRM ).setType( V_TEXT ).set( this->tic.prm );
+            break;
+        case let_relais:
+            msg.setSensor( CHILD_ID_RELAIS ).setType( V_TEXT ).set( this->tic.relais );
+            break;
+        case let_ntarf:
+            msg.setSensor( CHILD_ID_NTARF ).setType( V_TEXT ).set( this->tic.ntarf );
+            break;
+        case let_njourf:
+            msg.setSensor( CHILD_ID_NJOURF ).setType( V_TEXT ).set( this->tic.njourf );
+            break;
+        case let_njourf1:
+            msg.setSensor( CHILD_ID_NJOURF_1 ).setType( V_TEXT ).set( this->tic.njourf1 );
+            break;
+        case let_hchp:
+            msg.setSensor( CHILD_ID_HCHP ).setType( V_STATUS ).set( this->tic.hchp );
+            break;
+        case let_next: {
+            // 'HH:MM nn' (start time and index of the next period), or '-' if unknown
+            char next[9];
+            if( this->tic.next == LINKY_SCHED_NONE ){
+                strcpy( next, "-" );
+            } else {
+                uint16_t minute = linkySchedMinute( this->tic.next );
+                uint8_t idx = linkySchedIndex( this->tic.next );
+                next[0] = '0'+minute/600;
+                next[1] = '0'+( minute/60 )%10;
+                next[2] = ':';
+                next[3] = '0'+( minute%60 )/10;
+                next[4] = '0'+minute%10;
+                next[5] = ' ';
+                next[6] = '0'+idx/10;
+                next[7] = '0'+idx%10;
+                next[8] = '\0';
+            }
+            msg.setSensor( CHILD_ID_NEXT_SWITCH ).setType( V_TEXT ).set( next );
+            break;
+        }
+        case let_power:
+            msg.setSensor( CHILD_ID_POWER ).setType( V_WATT ).set( this->tic.power );
+            break;
+        case let_hhpower:
+            msg.setSensor( CHILD_ID_HALFHOUR ).setType( V_WATT ).set( this->tic.hhpower );
+            break;
+        case let_net:
+            msg.setSensor( CHILD_ID_NET_POWER ).setType( V_VA ).set( this->tic.net );
+            break;
+        default:
+            /* PJOURF+1 is only used locally */
+            return( false );
+    }
+    this->sendMsg( msg );
+    return( true );
+}
+
+/**
+ * Linky::sendGroup:
+ * @i: the index of the bit group in st_stge[].
+ * 
+ * Send the value of a STGE bit group.
+ *
+ * Private.
+ */
+void Linky::sendGroup( uint8_t i )
+{
+    MyMessage msg;
+    linky_stge_t grp;
+    memcpy_P( &grp, &st_stge[i], sizeof( linky_stge_t ));
+    uint32_t mask = (( 1UL << grp.width )-1 ) << grp.shift;
+    uint8_t value = ( this->tic.stge & mask ) >> grp.shift;
+    msg.clear();
+    if( grp.width == 1 ){
+        this->sendMsg( msg.setSensor( grp.child ).setType( V_STATUS ).set( value ));
+    } else {
+        this->sendMsg( msg.setSensor( grp.child ).setType( V_TEXT ).set( value ));
+    }
+}
+
+/**
+ * Linky::sendMsg:
+ * @msg: the message to be sent.
+ * 
+ * Send a message, the caller having checked that the pacing wait has elapsed (see sendReady()).
+ * The wait is doubled each time a message does not reach the gateway, and decreased by 1 ms
+ * on each success, between WAITMS and WAITMS_MAX.
+ *
+ * Returns: %TRUE if the message has reached the gateway.
+ *
+ * Public.
+ */
+bool Linky::sendMsg( MyMessage &msg )
+{
+    bool ok = ::send( msg );
+    this->send_ms = millis();
+    this->_sent += 1;
+    if( ok ){
+        if( this->pace_ms > WAITMS ){
+            this->pace_ms -= 1;
+        }
+    } else {
+        this->_fails += 1;
+        this->pace_ms = ( this->pace_ms > WAITMS_MAX/2 ) ? WAITMS_MAX : 2*this->pace_ms;
+    }
+    return( ok );
+}
+
+/**
+ * Linky::scheduleDay:
+ * 
+ * Called when a new DATE has been decoded, before PJOURF+1 in the same trame.
+ * On day change, tomorrow's profile becomes today's schedule.
+ *
+ * Private.
+ */
+void Linky::scheduleDay( void )
+{
+    uint8_t day = 10*( this->tic.date[5]-'0' )+( this->tic.date[6]-'0' );
+    if( day != this->sched_day ){
+        // do not take tomorrow's profile for today's at startup
+        if( this->sched_day ){
+            memcpy( this->sched, this->tic.pjourf1, sizeof( this->sched ));
+            this->sched_seed = false;
+        }
+        this->sched_day = day;
+    }
+}
+
+/**
+ * Linky::scheduleUpdate:
+ * 
+ * Called on each committed trame.
+ * - learn the HP/HC meaning of the current index from LTARF
+ * - until the first day change, seed today's schedule from tomorrow's profile
+ * - determine the current index and the next switch from today's schedule
+ * - drive the HC/HP LEDs from the current index, falling back to LTARF.
+ *
+ * Private.
+ */
+void Linky::scheduleUpdate( void )
+{
+    const char *date = this->tic.date;
+    uint16_t now = 60*( 10*( date[7]-'0' )+( date[8]-'0' ))+( 10*( date[9]-'0' )+( date[10]-'0' ));
+    uint8_t cur = this->tic.ntarf;
+    uint16_t next = LINKY_SCHED_NONE;
+
+    if( this->ltarf_hp >= 0 && cur > 0 && cur < 16 ){
+        bitSet( this->sched_known, cur );
+        bitWrite( this->sched_hp, cur, this->ltarf_hp );
+    }
+
+    if( this->sched[0] == LINKY_SCHED_NONE && !this->sched_seed && this->tic.pjourf1[0] != LINKY_SCHED_NONE ){
+        memcpy( this->sched, this->tic.pjourf1, sizeof( this->sched ));
+        this->sched_seed = true;
+    }
 
-    } else if( !strcmp_P( this->_pDec, PLy_prm )){
-        found = true;
-        this->decData(( char * ) this->tic.prm, let_prm );
-      
-    } else if( !strcmp_P( this->_pDec, PLy_ntarf )){
-        found = true;
-        this->decData( &this->tic.ntarf, let_ntarf );
+    if( this->sched[0] != LINKY_SCHED_NONE && date[0] ){
+        for( uint8_t i=0 ; i<LINKY_SCHED_SIZE && this->sched[i] != LINKY_SCHED_NONE ; ++i ){
+            if( linkySchedMinute( this->sched[i] ) <= now ){
+                cur = linkySchedIndex( this->sched[i] );
+            } else if( linkySchedIndex( this->sched[i] ) != cur ){
+                next = this->sched[i];
+                break;
+            }
+        }
+        // a seeded schedule which does not match the actual index is not today's one
+        if( this->sched_seed && cur != this->tic.ntarf ){
+            memset( this->sched, 0xff, sizeof( this->sched ));
+            cur = this->tic.ntarf;
+            next = LINKY_SCHED_NONE;
+        // no more switch today: the next one may be at the start of tomorrow
+        } else if( next == LINKY_SCHED_NONE && this->tic.pjourf1[0] != LINKY_SCHED_NONE && linkySchedIndex( this->tic.pjourf1[0] ) != cur ){
+            next = this->tic.pjourf1[0];
+        }
+    }
 
-    } else if( this->logIgnoredGet()){
-        this->logIgnored();
+    if( cur > 0 && cur < 16 && bitRead( this->sched_known, cur )){
+        this->hchpSet( bitRead( this->sched_hp, cur ));
+    } else if( this->ltarf_hp >= 0 ){
+        this->hchpSet( this->ltarf_hp );
     }
 
-#ifdef LINKY_DEBUG
-    if( !found ){
-        Serial.print( F( " ignored" ));
-    } else {
-        Serial.print( F( " ok" ));
+    if( next != this->tic.next ){
+        this->tic.next = next;
+        dnfrSet( let_next );
     }
-#endif
 }
 
 /**
- * Linky::ig_receive:
+ * Linky::sendLog:
+ * @text: the log to be sent.
+ *
+ * Private.
+ */
+void Linky::sendLog( const char *text )
+{
+    MyMessage msg;
+    msg.clear();
+    this->sendMsg( msg.setSensor( CHILD_MAIN_LOG ).setType( V_TEXT ).set( text ));
+}
+
+/**
+ * Linky::sendMessage:
+ * @i: 0 for MSG1, 1 for MSG2.
  * 
- * Get the new information group from the serial input,
- *  and stores it in the current _pRec reception buffer.
- *  Validates the checksum.
- *  Switch the reception buffer ater checksum validation.
- *  
- * The method exits either at end of information group (and checksum valide), or if
- * there is no more available character in the serial input.
+ * Send the next chunk of the queued message. After the last one, the hash of the text is recorded as
+ * sent, unless a chunk has failed.
  *
  * Private.
  */
-void Linky::ig_receive()
+void Linky::sendMessage( uint8_t i )
 {
-    while( this->linkySerial.available()){                   /* At least 1 char has been received */
-        char c = this->linkySerial.read() & 0x7f;            /* Read char, exclude parity */
-#ifdef LINKY_DEBUG
-        //Serial.print( F( "Serial.read() c=" )); Serial.println( c, HEX );
-#endif
-        /* On going reception */
-        if( bitRead( this->_FR, lst_Rec )){
-            /* Received end of information group char, aka CR, aka \r, aka 0x0D */
-            if( c == Car_EOIG ){   
-                bitClear( this->_FR, lst_Rec );       /* Receiving complete */
-                this->_iCks = this->_iRec-1;                /* Index of Cks in the message */
-                *(this->_pRec+this->_iRec) = '\0';          /* Terminate the string */
-#ifdef LINKY_DEBUG
-                //Serial.print( F( "Found EOIG=" ));
-                //Serial.println( _pRec );
-#endif
-                /* if checksum is OK, swap the buffers and decode the group */
-                if( this->ig_checksum()){
-                    bitSet( this->_FR, lst_Dec );         /* Next step, decoding group information */
-                    /* Swap reception and decode buffers */
-                    if( bitRead( this->_FR, lst_RxB )){   /* Receiving in B, Decode in A, swap */
-                        bitClear( this->_FR, lst_RxB );
-                        this->_pRec = this->_BfA;               /* --> Receive in A */
-                        this->_pDec = this->_BfB;               /* --> Decode in B */
-#ifdef LINKY_DEBUG
-                        //Serial.println( F( "receive() set _pRec=_BfA, _pDec=_BfB" ));
-#endif
-                    } else {                        /* Receiving in A, Decode in B, swap */
-                        bitSet( this->_FR, lst_RxB );
-                        this->_pRec = this->_BfB;               /* --> Receive in B */
-                        this->_pDec = this->_BfA;               /* --> Decode in A */
-#ifdef LINKY_DEBUG
-                        //Serial.println( F( "receive() set _pRec=_BfB, _pDec=_BfA" ));
-#endif
-                    }
-                /* if checksum is not ok, keep the same buffer */
-                } else {
-                    this->_iRec = 0;
-                }
+    MyMessage msg;
+    char buffer[1+MAX_PAYLOAD];
+    const char *text = i ? this->msg2 : this->msg1;
+    uint8_t len = strlen( text );
+    uint8_t count = len ? ( len+LINKY_MSG_CHUNK-1 ) / LINKY_MSG_CHUNK : 1;
+    uint8_t chunk = this->msg_chunk[i]++;
+
+    buffer[0] = '1'+chunk;
+    buffer[1] = '/';
+    buffer[2] = '0'+count;
+    buffer[3] = ':';
+    strncpy( buffer+4, text+chunk*LINKY_MSG_CHUNK, LINKY_MSG_CHUNK );
+    buffer[4+LINKY_MSG_CHUNK] = '\0';
+    msg.clear();
+    if( !this->sendMsg( msg.setSensor( i ? CHILD_ID_MSG2 : CHILD_ID_MSG1 ).setType( V_TEXT ).set( buffer ))){
+        bitSet( this->msg_fail, i );
+    }
+    if( chunk+1 >= count ){
+        bitClear( this->msg_pend, i );
+        if( !bitRead( this->msg_fail, i )){
+            this->msg_hash[i] = linkyHash( text );
+        }
+    }
+}
 
-            /* Other character during information group reception */
-            } else {
-                *(this->_pRec+this->_iRec) = c;             /* Store received character */
-                this->_iRec += 1;
-                if( this->_iRec >= LINKY_BUFSIZE-1 ){       /* Buffer overflow */
-                    bitClear( this->_FR, lst_Rec );         /* Stop reception and do nothing */
-                    *(this->_pRec+LINKY_BUFSIZE-1) = '\0';
-                    Serial.print( this->_pRec );
-                    Serial.print( F( " buffer overflow (" ));
-                    Serial.print( LINKY_BUFSIZE );
-                    Serial.println( F( " bytes)" ));
+/**
+ * Linky::sendNext:
+ * 
+ * Send at most one message from the send queues, by priority order, once the pacing wait has elapsed
+ * since the previous message.
+ *
+ * Private.
+ */
+void Linky::sendNext( void )
+{
+    if( !this->sendReady()){
+        return;
+    }
+    /* the TIC informations wait for a valid trame, but not the diagnostics nor the logs */
+    if( !bitRead( this->_FR, lst_Val )){
+        this->sendDiag();
+        return;
+    }
+    /* alarms, then changed STGE groups */
+    if( this->_stge_pend ){
+        for( uint8_t q=lqu_alarm ; q<=lqu_value ; ++q ){
+            for( uint8_t i=0 ; i<LINKY_STGE_COUNT ; ++i ){
+                uint32_t mask = linkyStgeMask( i );
+                if(( this->_stge_pend & mask ) && ( q == lqu_value || ( mask & LINKY_STGE_ALARM ))){
+                    this->_stge_pend &= ~mask;
+                    this->sendGroup( i );
+                    this->queueSent( q );
+                    return;
                 }
             }
-
-        /* Reception not yet started, trying to start it 
-            At startup, wait until we have catch the start of the trame */
-        } else if( this->stx_ms > 0 && c == Car_SOIG ){   /* Received start of information group */
-            this->_iRec = 0;
-            bitSet( this->_FR, lst_Rec );             /* Start reception */
-#ifdef LINKY_DEBUG
-            //Serial.println( F( "received SOIG" ));
-#endif
-
-        /* start of trame */
-        } else if( c == Car_STX ){
-            this->stx_ms = millis();
-#ifdef LINKY_DEBUG
-            //Serial.println( F( "received STX" ));
-#endif
-
-        /* if end of trame 
-            we assume that we get one trame every sec. at 9600 bauds
-            As of 2025-10- 1 (v4.0-2025) delay=1697 */
-        } else if( c == Car_ETX ){
-            uint32_t now = millis();
-            uint32_t delay = now - this->stx_ms;
-#ifdef LINKY_DEBUG
-            Serial.print( F( "received ETX, delay=" ));
-            Serial.println( delay );
-#endif
-            this->trameLedSet( delay < 2000 ? TRAMEOK_MS : TRAMENOTOK_MS );
         }
     }
+    /* changed values */
+    for( uint8_t i=0 ; i<let_count ; ++i ){
+        if( pendRead( i )){
+            pendClear( i );
+            if( this->sendEtiq( i, false )){
+                this->queueSent( lqu_value );
+                return;
+            }
+        }
+    }
+    /* changed supplier messages, one chunk at a time */
+    for( uint8_t i=0 ; i<2 ; ++i ){
+        if( bitRead( this->msg_pend, i )){
+            this->sendMessage( i );
+            this->queueSent( lqu_value );
+            return;
+        }
+    }
+    /* fixed text logs */
+    for( uint8_t i=0 ; i<llg_count ; ++i ){
+        if( bitRead( this->log_pend, i )){
+            char buffer[1+LINKY_LOG_SIZE];
+            bitClear( this->log_pend, i );
+            strcpy_P( buffer, ( const char * ) pgm_read_word( &st_logs[i] ));
+            this->sendLog( buffer );
+            this->queueSent( lqu_value );
+            return;
+        }
+    }
+    /* increments of the closed day and month */
+    for( uint8_t n=0 ; this->energy_pend && n<16 ; ++n ){
+        if( bitRead( this->energy_pend, n )){
+            this->sendClosed( n );
+            this->queueSent( lqu_value );
+            return;
+        }
+    }
+    /* sequence number, once the changed values have been sent */
+    if( this->seq_pend ){
+        this->seq_pend = false;
+        this->sendSeq( this->seq_ack );
+        this->queueSent( lqu_value );
+        return;
+    }
+    /* full report: fields, STGE groups, running energy increments, then the sequence number */
+    while( this->dump_next < LINKY_DUMP_COUNT ){
+        uint8_t item = this->dump_next++;
+        bool sent = true;
+        if( item < let_count ){
+            sent = this->sendEtiq( item, true );
+        } else if( item < let_count+LINKY_STGE_COUNT ){
+            this->sendGroup( item-let_count );
+        } else if( item < let_count+LINKY_STGE_COUNT+2 ){
+            sent = this->sendEnergy( item-let_count-LINKY_STGE_COUNT );
+        } else {
+            this->sendSeq( this->seq );
+        }
+        if( sent ){
+            this->queueSent( lqu_dump );
+            return;
+        }
+    }
+    this->dump_next = LINKY_DUMP_NONE;
+    /* diagnostics, then the ignored label log */
+    this->sendDiag();
 }
 
 /**
- * Linky::logIgnored:
+ * Linky::sendReady:
  * 
- * Duplicate the trames reception to the output thread is asked for.
- * A buffer is built with trimmed label and values, '|'-separated.
+ * The sketch may send its own messages with sendMsg() when this returns %TRUE after loop(), i.e.
+ * when loop() has had nothing to send, so that they are paced with the Linky ones.
  *
- * Private.
+ * Returns: %TRUE if the pacing wait has elapsed since the previous message.
+ *
+ * Public.
  */
-void Linky::logIgnored()
+bool Linky::sendReady( void )
 {
-    char buffer[1+MAX_PAYLOAD];   // MySensors max payload is 25 bytes
-    memset( buffer, '\0', sizeof( buffer ));
+    return( millis()-this->send_ms >= this->pace_ms );
+}
 
-    // prefix
-    strcpy( buffer, "[I]: " );
-    uint8_t len = strlen( buffer );
+/**
+ * Linky::sendSeq:
+ * @seq: the sequence number.
+ * 
+ * Send a sequence number on the resync child.
+ *
+ * Private.
+ */
+void Linky::sendSeq( uint16_t seq )
+{
+    MyMessage msg;
+    char buffer[6];
+    utoa( seq, buffer, 10 );
+    msg.clear();
+    this->sendMsg( msg.setSensor( CHILD_MAIN_ACTION_RESYNC ).setType( V_TEXT ).set( buffer ));
+}
 
-    // label
-    char *p = this->_pDec;
-    strncat( buffer, p, MAX_PAYLOAD-len );
-    len = strlen( buffer );
+/**
+ * Linky::timingItem:
+ * @item: the item of the timing report.
+ * 
+ * Send the trame timing as 'ifi=avg/max', 'dur=avg/max' (ms), 'drift=ppm' and 'first=ms', then restart
+ * the max after the last item.
+ *
+ * Returns: %TRUE.
+ *
+ * Private.
+ */
+bool Linky::timingItem( uint8_t item )
+{
+    MyMessage msg;
+    char buffer[1+MAX_PAYLOAD];
+
+    switch( item ){
+        case 0:
+            strcpy( buffer, "ifi=" );
+            utoa( this->ifi_avg, buffer+strlen( buffer ), 10 );
+            strcat( buffer, "/" );
+            utoa( this->ifi_max, buffer+strlen( buffer ), 10 );
+            break;
+        case 1:
+            strcpy( buffer, "dur=" );
+            utoa( this->dur_avg, buffer+strlen( buffer ), 10 );
+            strcat( buffer, "/" );
+            utoa( this->dur_max, buffer+strlen( buffer ), 10 );
+            break;
+        case 2:
+            strcpy( buffer, "drift=" );
+            itoa( this->drift_ppm, buffer+strlen( buffer ), 10 );
+            break;
+        case 3:
+            // time from the boot to the first valid trame
+            strcpy( buffer, "first=" );
+            ultoa( this->first_ms, buffer+strlen( buffer ), 10 );
+            break;
+#ifdef ICPSERIAL
+        case 4:
+            // CPU cycles in the reception interrupts per character
+            strcpy( buffer, "isr=" );
+            utoa( this->linkySerial.getCycles(), buffer+strlen( buffer ), 10 );
+            strcat( buffer, "/" );
+            utoa( this->linkySerial.getCyclesMax(), buffer+strlen( buffer ), 10 );
+            break;
+#endif
+    }
+    msg.clear();
+    this->sendMsg( msg.setSensor( CHILD_ID_TIMING ).setType( V_TEXT ).set( buffer ));
 
-    // value
-    p = strtok( NULL, CLy_Sep );
-    if( p && p[0] && len<MAX_PAYLOAD-1 ){
-        buffer[len] = '|';
-        len += 1;
-        String str = p;
-        str.trim();
-        strncat( buffer, str.c_str(), MAX_PAYLOAD-len );
+    if( item == this->diagCount( ldg_timing )-1 ){
+        this->ifi_max = 0;
+        this->dur_max = 0;
     }
+    return( true );
+}
 
-    this->sendLog(( char * ) buffer );
+/**
+ * Linky::timingSend:
+ * 
+ * Queue the trame timing report (see timingItem()).
+ *
+ * Public.
+ */
+void Linky::timingSend( void )
+{
+    this->diagQueue( ldg_timing );
 }
 
 /**
- * Linky::sendLog:
- * @msg: a message to be sent.
+ * Linky::timingUpdate:
+ * 
+ * Called on each committed trame with a DATE.
+ * - estimate the drift of the local clock against the meter one
+ * - report the mean power of each completed half-hour (see Linky.h).
  *
  * Private.
  */
-void Linky::sendLog( char *text )
+void Linky::timingUpdate( void )
 {
-    MyMessage msg;
-    msg.clear();
-    ::send( msg.setSensor( CHILD_MAIN_LOG ).setType( V_TEXT ).set( text ));
+    uint32_t now = this->dateSeconds();
+    uint32_t step = ( now+86400UL-this->drift_sod ) % 86400UL;
+
+    if( this->drift_sod == LINKY_POWER_NONE || step > LINKY_DRIFT_STEP ){
+        this->drift_ms = this->stx_ms;
+        this->drift_s = 0;
+    } else {
+        this->drift_s += step;
+        if( this->drift_s >= LINKY_DRIFT_WINDOW ){
+            int32_t diff = ( int32_t )( this->stx_ms-this->drift_ms ) - ( int32_t )( 1000UL*this->drift_s );
+            this->drift_ppm = diff * 1000 / ( int32_t ) this->drift_s;
+#ifdef LINKY_DEBUG
+            Serial.print( F( "Linky::timingUpdate() drift_ppm=" )); Serial.println( this->drift_ppm );
+#endif
+            this->drift_ms = this->stx_ms;
+            this->drift_s = 0;
+        }
+    }
+    this->drift_sod = now;
+
+    uint8_t slot = now / 1800;
+    if( slot != this->hh_slot ){
+        if( this->hh_slot != LINKY_HALFHOUR_NONE && ( this->hh_slot+1 ) % 48 == slot && this->tic.east >= this->hh_east ){
+            // Wh over a half-hour, i.e. twice the mean W
+            uint32_t power = 2*( this->tic.east-this->hh_east );
+            this->tic.hhpower = power > 0xffff ? 0xffff : power;
+            dnfrSet( let_hhpower );
+        }
+        this->hh_slot = slot;
+        this->hh_east = this->tic.east;
+    }
 }
 
 /**
@@ -984,9 +3352,8 @@ void Linky::sendLog( char *text )
  *    on 0,1 s
  *    off 0,9 s
  *
- * This is managed with timers :
- * - one timer lights on the LED, depending of the desired frequency (3s if OK, 1s else)
- * - one timer lights off the LED, 0,1s after
+ * This is managed with a single one-shot timer, which alternately lights on the LED for 0,1s, and lights
+ * it off until the end of the period (3s if OK, 1s else).
  *
  * Private.
  */
@@ -996,9 +3363,11 @@ void Linky::trameLedSet( uint32_t period_ms )
     Serial.print( F( "trameLedSet() period_ms=" ));
     Serial.println( period_ms );
 #endif
-    if( this->led_status_timer.getDelay() != period_ms ){
-        this->led_status_timer.setDelay( period_ms );
-        this->led_status_timer.restart();
+    if( this->led_period_ms != period_ms ){
+        this->led_period_ms = period_ms;
+        this->ledOff( this->ledPin );
+        this->led_timer.setDelay( period_ms );
+        this->led_timer.restart();
     }
 
     if( period_ms == TRAMEOK_MS ){
@@ -1008,6 +3377,86 @@ void Linky::trameLedSet( uint32_t period_ms )
     }
 }
 
+/**
+ * Linky::validate:
+ * @stat: the statistics of the field.
+ * @value: the received value.
+ * @dev: the minimal accepted deviation.
+ * 
+ * Check the value against the statistics of the field, and update them (see Linky.h).
+ * An out of band value is held until the next one, which tells whether it was a step or a glitch,
+ * the glitch being then counted as invalid here.
+ * 
+ * Returns: %TRUE if the value is accepted, %FALSE if it is held.
+ *
+ * Private.
+ */
+bool Linky::validate( linky_stat_t *stat, uint16_t value, uint16_t dev )
+{
+    uint32_t scaled = ( uint32_t ) value << 4;
+    uint16_t mean = stat->mean >> 4;
+    uint32_t diff = value > mean ? value-mean : mean-value;
+    uint32_t d2 = diff * diff;
+    bool valid = true;
+
+    if( stat->count == 0 ){
+        stat->mean = scaled;
+        stat->var = 0;
+
+    } else if( stat->count >= LINKY_STAT_WARMUP ){
+        uint32_t base = stat->var + ( uint32_t ) dev * dev;
+        // k2*base would overflow: the variance is so large that anything goes
+        if( base < 0x0a000000UL ){
+            valid = ( d2 <= ( LINKY_STAT_K2_MAX - ( this->cks_rate >> 4 )) * base );
+        }
+    }
+
+    uint8_t side = valid ? 0 : ( value > mean ? 1 : 2 );
+    if( stat->held && stat->held != side ){
+        // the held value has not been confirmed: it was a glitch
+        char buffer[6];
+        utoa( stat->value, buffer, 10 );
+        this->decError( ler_invalid, this->_startLabel, buffer );
+    }
+    if( !valid && stat->held != side ){
+        stat->held = side;
+        stat->value = value;
+        return( false );
+    }
+
+    if( !valid ){
+        // an actual step: restart from this value, with the step as the variance
+        stat->mean = scaled;
+        stat->var = d2;
+    } else if( stat->count ){
+        if( scaled >= stat->mean ){
+            stat->mean += ( scaled-stat->mean ) >> LINKY_STAT_SHIFT;
+        } else {
+            stat->mean -= ( stat->mean-scaled ) >> LINKY_STAT_SHIFT;
+        }
+        stat->var = stat->var - ( stat->var >> LINKY_STAT_SHIFT ) + ( d2 >> LINKY_STAT_SHIFT );
+    }
+    stat->held = 0;
+    if( stat->count < LINKY_STAT_WARMUP ){
+        stat->count += 1;
+    }
+    return( true );
+}
+
+/**
+ * Linky::CheckpointCb:
+ * @user_data: a pointer to the Linky instance.
+ * 
+ * Periodically checkpoint the energy indexes.
+ *
+ * Static private.
+ */
+void Linky::CheckpointCb( void *user_data )
+{
+    Linky *instance = ( Linky *) user_data;
+    instance->checkpoint();
+}
+
 /**
  * Linky::MaxPeriodCb:
  * @user_data: a pointer to the Linky instance.
@@ -1019,7 +3468,9 @@ void Linky::trameLedSet( uint32_t period_ms )
 void Linky::MaxPeriodCb( void *user_data )
 {
     Linky *instance = ( Linky *) user_data;
-    instance->send( true );
+    if( bitRead( instance->_FR, lst_Val )){
+        instance->send( true );
+    }
 }
 
 /**
@@ -1033,7 +3484,9 @@ void Linky::MaxPeriodCb( void *user_data )
 void Linky::MinPeriodCb( void *user_data )
 {
     Linky *instance = ( Linky *) user_data;
-    instance->send( false );
+    if( bitRead( instance->_FR, lst_Val )){
+        instance->send( false );
+    }
 }
 
 /**
@@ -1057,34 +3510,25 @@ void Linky::TrameTimeoutCb( void *data )
 }
 
 /**
- * Linky::TrameLedOnCb:
- * @data: a pointer to the Linky instance.
- * 
- * This timer is configured to run once with a 0.1 sec delay.
- * It is started when the LED is lighted on.
- * The LED must be lighted off at timer expiration.
- *
- * Static private.
- */
-void Linky::TrameLedOnCb( void *data )
-{
-    Linky *instance = ( Linky *) data;
-    instance->ledOff( instance->ledPin );
-}
-
-/**
- * Linky::TrameLedStatusCb:
+ * Linky::TrameLedCb:
  * @data: a pointer to the Linky instance.
  * 
- * This timer is configured to run continuously with a period depending of the LED status.
- * It is (re)started each time the status is changed.
+ * This timer is configured to run once, and is restarted from its callback: it lights on the LED for
+ * 0.1 sec, then lights it off until the end of the period. The period is (re)started each time the
+ * status is changed.
  *
  * Static private.
  */
-void Linky::TrameLedStatusCb( void *data )
+void Linky::TrameLedCb( void *data )
 {
     Linky *instance = ( Linky *) data;
-    instance->ledOn( instance->ledPin );
-    instance->led_on_timer.start();
+    if( instance->led_timer.getDelay() != TRAMELEDON_MS ){
+        instance->ledOn( instance->ledPin );
+        instance->led_timer.setDelay( TRAMELEDON_MS );
+    } else {
+        instance->ledOff( instance->ledPin );
+        instance->led_timer.setDelay( instance->led_period_ms-TRAMELEDON_MS );
+    }
+    instance->led_timer.start();
 }
 
@@ -24,18 +24,22 @@
  *
  * _FR : flag register
  *
- *   |  7  |  6  |   5  |   4  |   3  |  2  |   1  |   0  |
- *   |     |     | _Dec | _GId | _Cks |     | _RxB | _Rec |
+ *   |   7  |  6  |   5  |   4  |   3  |   2  |   1  |   0  |
+ *   | _Etx | _Cp | _Val | _Idx | _Err | _Dec | _RxB | _Rec |
  *
  *    _Rec : receiving
  *    _RxB : receive in buffer B, decode in buffer A
- *    _GId : Group identification
  *    _Dec : decode data
+ *    _Err : an error has been detected in the current trame
+ *    _Idx : EAST has been validated in the current trame
+ *    _Val : at least one valid trame has been received since startup
+ *    _Cp  : the energy indexes have changed since last checkpoint
+ *    _Etx : end of trame received, the trame is to be committed
  *
  * _DNFR : data available flags
  *
- *   |  7  |  6  |  5  |  4  |  3  |   2   |   1    |   0   |
- *   |     |     |     |     |     | _papp | _iinst | _base |
+ *   A bitset of let_count bits, one per linky_etiq_t value, packed in bytes (see dnfrSet() and co).
+ *   Each of the 14 energy indexes has its own bit, so that only the moving ones are reported.
  *
  * Exemple of group :
  *      <LF>lmnopqr<SP>123456789<SP>C<CR>
@@ -71,8 +75,12 @@
  * EAST       Energie totale soutirée                        0           9     Wh     Oui
  * EASF01     Energie active soutirée fournisseur index 1    0           9     Wh     Oui               Oui
  * EASF02     Energie active soutirée fournisseur index 2    0           9     Wh     Oui               Oui
- * EASD01     Energie active soutirée distribut. index 1     0           9     Wh     Oui   =EASF01
- * EASF01     Energie active soutirée distribut. index 1     0           9     Wh     Oui   =EASF02
+ * EASF03..10 Energie active soutirée fournisseur index n    0           9     Wh     Oui               Oui
+ * EASD01     Energie active soutirée distribut. index 1     0           9     Wh     Oui   =EASF01     Oui
+ * EASD02     Energie active soutirée distribut. index 2     0           9     Wh     Oui   =EASF02     Oui
+ * EASD03..04 Energie active soutirée distribut. index n     0           9     Wh     Oui               Oui
+ * EAIT       Energie active injectée totale                 0           9     Wh     Oui
+ * ERQ1..4    Energie réactive Q1..Q4 totale                 0           9     VArh   Oui
  * IRMS1      Courant efficace, phase 1                      0           3     A      Oui               Oui
  * URMS1      Tension efficace, phase 1                      0           3     V      Oui               Oui
  * PREF       Puissance apparente de référence               0           2     kVA    Oui               Oui
@@ -80,8 +88,13 @@
  * SINSTS     Puissance app. instantanée soutirée            0           5     VA     Oui               Oui
  * SMAXSN     Puissance app. max. soutirée n                 13          5     VA     Oui               Oui
  * SMAXSN-1   Puissance app. max. soutirée n-1               13          5     VA     Oui               Oui
+ * SINSTI     Puissance app. instantanée injectée            0           5     VA     Oui
+ * SMAXIN     Puissance app. max. injectée n                 13          5     VA     Oui
+ * SMAXIN-1   Puissance app. max. injectée n-1               13          5     VA     Oui
  * CCASN      Point n de la courbe de charge active soutirée 13          5     W      Oui               Oui
  * CCASN-1    Point n-1 de la courbe de charge active sout.  13          5     W      Oui               Oui
+ * CCAIN      Point n de la courbe de charge active injectée 13          5     W      Oui
+ * CCAIN-1    Point n-1 de la courbe de charge active inj.   13          5     W      Oui
  * UMOY1      Tension moyenne phase 1                        13          3     V      Oui
  * STGE       Registre de statuts                            0           8            Oui
  * MSG1       Message                                        0           32           Oui
@@ -89,31 +102,292 @@
  * PRM        "le" PRM, aka point de livraison (PDL)         0           14           Oui               Oui
  * RELAIS     Relais                                         0           3            Oui
  * NTARF      Numéro de l'index tarifaire en cours           0           2            Oui               Oui
- * NJOURF     Numéro du jour en cours calendrier fournisseur 0           2            Oui
- * NJOURF+1   Numéro de prochain jour calendrier fournisseur 0           2            Oui
- * PJOURF+1   Profil du prochain jour calendrier fournisseur 0           98           Oui
+ * NJOURF     Numéro du jour en cours calendrier fournisseur 0           2            Oui               Oui
+ * NJOURF+1   Numéro de prochain jour calendrier fournisseur 0           2            Oui               Oui
+ * PJOURF+1   Profil du prochain jour calendrier fournisseur 0           98           Oui               Oui
  * 
- * Max considered size = 30 oct.
+ * Max considered size = 4+1+32+1+1 = 39 oct. (MSG1)
+ * PJOURF+1 (8+1+98+1+1 = 109 oct.) is not buffered as is: ig_receive() converts each 'HHMMSSSS' block
+ * to its schedule entry as soon as it is complete, and stores it as LINKY_SCHED_CHARS printable chars,
+ * so that the group fits in 8+1+11*3+1+1 = 44 oct. The checksum is computed on the fly on the received
+ * chars.
+ *
+ * Tariff schedule
+ * ===============
+ * PJOURF+1 is made of 11 blocks 'HHMMSSSS' (or 'NONUTILE'), where HHMM is the start time of the
+ * period, and the low nibble of the SSSS hex action code is the supplier index to be used.
+ * Each block is stored as a 16 bits schedule entry: start minute of the day (11 bits) | index << 11.
+ * Tomorrow's profile, as received, becomes today's schedule when the DATE day changes. The schedule
+ * lets us know the current index and the time of the next switch; the HP/HC meaning of each index is
+ * learnt from LTARF, which remains the only source until a today's schedule is known.
+ * At startup, the first PJOURF+1 seeds today's schedule, as most contracts repeat the same daily
+ * profile: the seed is dropped as soon as it disagrees with NTARF, and replaced on the day change.
+ *
+ * Status register
+ * ===============
+ * STGE is a 32 bits register, sent as 8 hex chars. Each bit group has its own child (see st_stge[] in
+ * Linky.cpp), and is only reported when it changes (or on max period):
+ *
+ *   bit  0     contact sec                     0: fermé, 1: ouvert
+ *   bits 1-3   organe de coupure               0: fermé, 1: surpuissance, 2: surtension, 3: délestage,
+ *                                              4: ordre CPL/Euridis, 5-6: surchauffe
+ *   bit  4     cache-bornes distributeur       0: fermé, 1: ouvert
+ *   bit  6     surtension sur une des phases
+ *   bit  7     dépassement de la puissance de référence
+ *   bit  8     producteur/consommateur         0: consommateur, 1: producteur
+ *   bit  9     sens de l'énergie active        0: positive, 1: négative
+ *   bits 10-13 tarif en cours fournisseur      index-1
+ *   bits 14-15 tarif en cours distributeur     index-1
+ *   bit  16    mode dégradé de l'horloge
+ *   bit  17    mode de la TIC                  0: historique, 1: standard
+ *   bits 19-20 sortie communication Euridis    0: désactivée, 1: sans sécurité, 3: avec sécurité
+ *   bits 21-22 statut du CPL                   0: New/Unlock, 1: New/Lock, 2: Registered
+ *   bit  23    synchronisation CPL
+ *   bits 24-25 couleur Tempo du jour           0: pas d'annonce, 1: bleu, 2: blanc, 3: rouge
+ *   bits 26-27 couleur Tempo du lendemain      id.
+ *   bits 28-29 préavis pointe mobile (EJP)     0: aucun, 1-3: PM1-PM3
+ *   bits 30-31 pointe mobile en cours          id.
+ *
+ * Supplier messages
+ * =================
+ * MSG1 (32 chars) and MSG2 (16 chars) are right-trimmed and kept, along with a hash of the last sent text.
+ * When the decoded text differs from the sent one, it is queued on lqu_value, and sent one chunk per
+ * sendNext() call, split in 'i/n:text' chunks which fit in a MySensors payload. The hash is only updated
+ * when all the chunks have been sent: a failed send is so queued again with the next trame. A full
+ * report just forgets the hashes, so that the next trame queues them again.
+ *
+ * Ignored labels
+ * ==============
+ * When log_ignored is set, the ignored labels are recorded in a LINKY_IGNORED_SIZE open-addressed
+ * table (linear probing), keyed by the hash of the label, along with the hash of the last sent value.
+ * Each label is so reported the first time it is seen, then only when its value changes, or after
+ * LINKY_IGNORED_REFRESH minutes. Labels which do not fit in the table once it is full are not reported.
+ *
+ * Validation
+ * ==========
+ * IRMS1, URMS1 and SINSTS are validated against an exponentially weighted mean and variance of their
+ * previous accepted values (weight 1/2^LINKY_STAT_SHIFT), in fixed point integers:
+ *
+ *   accepted if (value-mean)^2 <= k2 * (variance + dev^2)
+ *
+ * where dev is a per-field minimal deviation, and k2 goes from LINKY_STAT_K2_MAX (clean link) down to
+ * LINKY_STAT_K2_MAX-15 (every group in checksum error), following an exponential average of the
+ * checksum errors. The first LINKY_STAT_WARMUP values are always accepted. An out of band value is
+ * held, the field keeping its previous value, until the next trame: if the next value is out of band
+ * on the same side, this is an actual step (e.g. a load being switched on), which is accepted, and the
+ * statistics are reseeded; else the held value was a glitch, and only then is counted as invalid.
+ * The cost is a few 32 bits integer multiplications and shifts per group.
+ *
+ * Decode errors
+ * =============
+ * The decode errors are counted by class (see linky_error_t), and the last LINKY_BAD_COUNT offending
+ * groups are kept, truncated to LINKY_BAD_SIZE chars. Both are sent on the errors child when the
+ * controller requests it.
+ *
+ * Active power
+ * ============
+ * SINSTS is an apparent power. The active power is derived from the EAST increments and the DATE
+ * horodates of the trames where they happen: P (W) = 3600 * delta_Wh / delta_s. Each sample is
+ * smoothed as an integer exponential average (1/2^LINKY_POWER_SHIFT weight), which is seeded with the
+ * first sample: no power is reported before it. While EAST does not move, the power is known to be less
+ * than 3600 / elapsed_s, which bounds the average.
+ *
+ * Producer
+ * ========
+ * The injection groups are only sent by meters in producer mode. EAIT and ERQ1..ERQ4 are validated as
+ * monotonic indexes, and checkpointed, as EAST. Once SINSTI has been received (even while nothing has
+ * been injected yet, EAIT being zero), the net apparent power SINSTS-SINSTI is updated on each committed
+ * trame: it is negative while injecting, and is reported as any other field, i.e. at the pace of the min
+ * period. A RULE_SURPLUS rule drives a pin locally while more than arg*100
+ * VA are injected.
+ *
+ * Energy accounting
+ * =================
+ * EAST and EASF01..EASF06 (enough for Tempo) are snapshotted on the first trame of each meter day and
+ * month, as given by DATE. When the day (resp. the month) changes, the integer increments since the
+ * snapshot are sent once on the closed day (resp. month) child as 'YYMMDD T=Wh' for EAST and
+ * 'YYMMDD nn=Wh' for each used EASFnn ('YYMM ...' for a month), and a new snapshot is taken. The day
+ * snapshots only keep the low 24 bits of the indexes, as a day never counts 16.7 MWh.
+ * The closed increments are queued as changed values (see Send queues): the indexes at the boundary are
+ * kept until each increment has been sent, and only then become the new snapshot.
+ * A period is only closed if its snapshot was taken on its boundary: a period which starts after a reboot,
+ * a reception gap of more than LINKY_ENERGY_GAP seconds or a meter change is never reported. The
+ * running EAST increments of the current day and month are sent with the full reports.
+ *
+ * Sizing histogram
+ * ================
+ * On each committed trame, SINSTS is counted in one of EEPROM_HISTOGRAM_SIZE log-scaled buckets of its
+ * ratio to PREF (PCOUP being PREF for residential contracts), the bucket bounds being half-octaves:
+ *
+ *   bucket  0     1     2     3     4     5     6     7     8     9     10
+ *   from    100%  71%   50%   35%   25%   18%   12%   9%    6%    4%    0%
+ *
+ * The bucket is found with at most ten comparisons against PREF shifted or scaled by 181/256 (1/sqrt(2)).
+ * The counters are only kept in EEPROM: the counts since the last write are 16 bits in SRAM, and are
+ * added to the EEPROM ones every LINKY_HISTOGRAM_EVERY checkpoints (less than 4000 trames). The EEPROM
+ * counters are 16 bits too, and are all halved when one of them would overflow: the ratios between
+ * the buckets are kept, the recent trames weighing more than the older ones. The histogram is restarted
+ * when PREF changes.
+ *
+ * Timing
+ * ======
+ * The interval between two STX and the duration of each trame are averaged (1/8 weight) and their
+ * max recorded. The drift of millis() is estimated against the DATE horodates over LINKY_DRIFT_WINDOW
+ * seconds of meter time, anchored on the STX of the trames. The time from the boot to the first valid
+ * trame is recorded too. These are sent on the timing child when the controller requests it.
+ *
+ * The half-hour boundaries are taken from DATE itself, so that they are those of CCASN, whatever the
+ * local clock drift: on each boundary, the EAST increment over the half-hour is reported as a mean
+ * power, which can be compared with CCASN-1. The first, partial, half-hour is not reported, neither
+ * a half-hour which does not follow the previous one (DST change, reception loss).
+ *
+ * Load shedding
+ * ==============
+ * Up to EEPROM_RULES rules drive output pins locally, on each committed trame, without waiting for the
+ * controller:
+ * - RULE_OVERLOAD: the pin is set while SINSTS is above arg % of PREF; it is switched (on or off) after
+ *   'frames' consecutive trames on the other side of the threshold
+ * - RULE_RELAIS: the pin follows the bit arg of RELAIS
+ * - RULE_SURPLUS: the pin is set while more than arg*100 VA are injected, with the same 'frames' delay
+ *   than RULE_OVERLOAD.
+ * Each evaluation is a few integer operations per rule.
+ *
+ * Send queues
+ * ===========
+ * Nothing is sent in a burst, neither from the timers nor from the controller requests: they only queue,
+ * and loop() sends at most one message per call, once the pacing wait (see sendMsg()) has elapsed since
+ * the previous one; the wait is never spent blocking, but in going back to the main loop (or, during the
+ * presentation, in receiving and decoding the TIC, see presentWait()). The node
+ * so goes back to the MySensors transport (i.e. to the forwarded messages when it is a repeater) and
+ * to the TIC reception between any two of its own messages. The queues are bitsets over the fields,
+ * so that a changed value is queued once whatever its count of changes, and is always sent with its
+ * last value. They are served in strict priority order:
+ * - lqu_alarm: the cut-off device, overvoltage and overload groups of STGE (LINKY_STGE_ALARM), queued
+ *   as soon as decoded, without waiting for the min period
+ * - lqu_value: the changed fields and STGE groups, queued on each min period, then the changed supplier
+ *   messages, the fixed text logs (HC/HP change, load shedding) and the increments of the closed day and
+ *   month, queued as soon as they happen; the logs are a bitset of linky_log_t, a log replacing its
+ *   pending opposite one; last, the sequence number reply to a resync (see seqSend())
+ * - lqu_dump: the full report, queued on each max period, as a cursor over all the fields
+ * - lqu_diag: the diagnostic reports requested by the controller (errors, timing, queues, histogram),
+ *   as a bitset of linky_diag_t and a cursor over the items of the report being sent
+ * - lqu_log: a single slot for the ignored labels log; while another queue or the slot is not empty,
+ *   the log is deferred: the label is then logged again with a next trame.
+ * The TIC informations wait for the first valid trame, but not the diagnostics nor the logs. The sketch
+ * queues its own replies and reports the same way, and sends them with sendMsg() when sendReady() says
+ * that loop() has had nothing to send, i.e. after all these queues. For each queue, the
+ * count of sent messages, the current and the max count of pending items and the max latency from the
+ * enqueue to the send (ms) are sent on the queues child as 'name=sent/depth/max/latency' when the
+ * controller requests it ('log=sent/deferred' for the logs).
+ *
+ * Incremental resync
+ * ==================
+ * Each committed trame has a 16 bits sequence number, which starts at a random value (the micros() of
+ * the first valid trame), and is sent on the resync child after each round of changed values, with each
+ * full report, or on request. The number sent after a round is the one of the trame the round was queued
+ * on, so that all the changes up to it have been sent before it.
+ * Each field records the epoch (sequence >> LINKY_SEQ_SHIFT, on 4 bits) of its last change. When the
+ * controller sets the resync child to the last sequence it knows, the fields changed since the epoch
+ * of this sequence are queued as changed values, and the current sequence is sent back. A field so
+ * may be sent again if it has changed in the same epoch just before the given sequence, but a change is
+ * never missed. The epochs are 4 bits, two fields per byte, and a field which has not changed since more
+ * than 8 epochs is marked as old (one field is checked per trame), so that the resync covers up to
+ * LINKY_SEQ_WINDOW trames (about 2 hours, so more than the default max period). An unknown sequence (older than that, newer than the current one, or
+ * given before the node reboot) triggers a full report instead. The closed energy periods are not
+ * part of the resync.
+ *
+ * Raw capture
+ * ===========
+ * When LINKY_CAPTURE is defined, each received TIC byte is echoed on the debug serial port with its high
+ * bit set, and each STX is followed by the millis() of its reception, as five 7 bits groups (LSB first),
+ * with their high bit set too. As the TIC and the debug outputs are both 7 bits ASCII, the capture
+ * survives the interleaved debug prints, which a reader just drops. build/ticcapture.pl stores such a
+ * stream in an indexed and block-compressed capture file. At 115200 bauds, the capture takes about 10%
+ * of the debug serial port.
  *
  **********************************************************************/
 #ifndef __LINKY_H__
 #define __LINKY_H__
 
+#include "icpSerial.h"
+#ifndef ICPSERIAL
 #include <SoftwareSerial.h>
-#include <pwiTimer.h>
+#endif
+#include "eeprom.h"
+#include "wheelTimer.h"
+
+class MyMessage;
+
+// uncomment to echo the raw TIC on the debug serial port (see build/ticcapture.pl)
+//#define LINKY_CAPTURE
+
+#define LINKY_CHECKPOINT_MS 3600000 /* checkpoint the energy indexes every hour */
+#define LINKY_HISTOGRAM_EVERY 1     /* checkpoint the histogram every hour */
+#define LINKY_REBASE_COUNT  60      /* accept a lower EAST after so many consecutive trames (meter change) */
 
 //#define LINKY_BUFSIZE       32    /* max size of the received, not ignored, information groups */
-#define LINKY_BUFSIZE       64    /* max size of the received, not ignored, information groups */
+#define LINKY_BUFSIZE       48    /* max size of the received, not ignored, information groups (MSG1) */
 #define LINKY_ADSC_SIZE     12
 #define LINKY_DATE_SIZE     13
 #define LINKY_LTARF_SIZE    16
 #define LINKY_NGTF_SIZE     16
 #define LINKY_PRM_SIZE      14
-#define LINKY_STGE_SIZE      8
+#define LINKY_STGE_SIZE      8      /* hex chars */
+#define LINKY_STGE_LABEL    17
 #define LINKY_VTIC_SIZE      2
 
+#define LINKY_INDEX_EASF    10      /* EASF01..EASF10 */
+#define LINKY_INDEX_EASD     4      /* EASD01..EASD04 */
+#define LINKY_INDEX_COUNT   ( LINKY_INDEX_EASF+LINKY_INDEX_EASD )
+#define LINKY_INDEX_LABEL    6      /* 'EASFnn' */
+#define LINKY_ERQ_COUNT      4      /* ERQ1..ERQ4 */
+
+#define LINKY_MSG1_SIZE     32
+#define LINKY_MSG2_SIZE     16
+#define LINKY_MSG_CHUNK     21      /* MAX_PAYLOAD less the 'i/n:' prefix */
+#define LINKY_LOG_SIZE      25      /* MAX_PAYLOAD */
+
+#define LINKY_IGNORED_SIZE   8      /* max count of distinct ignored labels */
+#define LINKY_IGNORED_REFRESH 60    /* min */
+
+#define LINKY_STAT_SHIFT     3      /* weight of a new value in the validation statistics */
+#define LINKY_STAT_WARMUP    8
+#define LINKY_STAT_K2_MAX   25      /* i.e. 5 standard deviations */
+#define LINKY_IRMS1_DEV      2      /* A */
+#define LINKY_URMS1_DEV      8      /* V */
+#define LINKY_SINSTS_DEV   400      /* VA */
+
+#define LINKY_BAD_COUNT      1      /* count of captured offending groups */
+#define LINKY_BAD_SIZE      23      /* MAX_PAYLOAD less the 'n:' prefix */
+
+#define LINKY_POWER_SHIFT    2      /* smoothing of the active power samples */
+#define LINKY_POWER_MAX_S 3600      /* resync if EAST did not move since so many seconds (DST change) */
+#define LINKY_POWER_NONE  0xffffffffUL
+
+#define LINKY_DRIFT_WINDOW 3600     /* s of meter time */
+#define LINKY_DRIFT_STEP    60      /* re-anchor if two DATE are more distant than that (s) */
+#define LINKY_HALFHOUR_NONE 0xff
+
+#define LINKY_ENERGY_COUNT   7      /* EAST, then EASF01..EASF06 */
+#define LINKY_ENERGY_GAP    60      /* s of meter time */
+
+#define LINKY_STGE_ALARM    0x000000ceUL  /* cut-off device, overvoltage, overload */
+#define LINKY_DUMP_NONE     0xff    /* no full report in progress */
+
+#define LINKY_SEQ_SHIFT      9      /* trames per epoch of the changes table, as a power of 2 */
+#define LINKY_SEQ_OLD        9      /* epoch age of the fields which have not changed in the window */
+#define LINKY_SEQ_WINDOW  ( 8U << LINKY_SEQ_SHIFT )        /* max age of a resync sequence (trames) */
+
+#define LINKY_SCHED_SIZE    11      /* count of blocks in PJOURF+1 */
+#define LINKY_SCHED_NONE    0xffff  /* unused schedule entry */
+#define LINKY_SCHED_BAD     0xfffe  /* invalid block */
+#define LINKY_SCHED_CHARS    3      /* printable chars of a received schedule entry */
+#define linkySchedMinute( e )       (( e ) & 0x07ff )
+#define linkySchedIndex( e )        (( e ) >> 11 )
+#define linkySchedEntry( min, idx ) (( uint16_t )( min ) | (( uint16_t )( idx ) << 11 ))
+
 typedef struct {
-    char        date[1+LINKY_DATE_SIZE];
+    uint32_t    stamp;                      /* packed date, see horodateStamp(), zero if none */
     uint16_t    value;
 }
   horodate_t;
@@ -125,21 +399,35 @@ typedef struct {
     char        ngtf[1+LINKY_NGTF_SIZE];
     char        ltarf[1+LINKY_LTARF_SIZE];
     uint32_t    east;
-    uint32_t    easf01;
-    uint32_t    easf02;
+    uint32_t    index[LINKY_INDEX_COUNT];   /* EASF01..EASF10, then EASD01..EASD04 */
+    uint32_t    eait;
+    uint32_t    erq[LINKY_ERQ_COUNT];
     uint8_t     irms1;
     uint16_t    urms1;
     uint8_t     pref;
     uint16_t    sinsts;
     horodate_t  smaxsn;
     horodate_t  smaxsnm1;
+    uint16_t    sinsti;
+    horodate_t  smaxin;
+    horodate_t  smaxinm1;
     horodate_t  ccasn;
     horodate_t  ccasnm1;
+    horodate_t  ccain;
+    horodate_t  ccainm1;
     horodate_t  umoy1;
-    char        stge[1+LINKY_STGE_SIZE];
+    uint32_t    stge;
     char        prm[1+LINKY_PRM_SIZE];
+    uint8_t     relais;
     uint8_t     ntarf;
+    uint8_t     njourf;
+    uint8_t     njourf1;
+    uint16_t    pjourf1[LINKY_SCHED_SIZE];
     bool        hchp;
+    uint16_t    next;                       /* next tariff switch, as a schedule entry */
+    uint16_t    power;                      /* derived active power (W) */
+    uint16_t    hhpower;                    /* mean active power over the last half-hour (W) */
+    int16_t     net;                        /* SINSTS-SINSTI (VA) */
 }
   tic_t;
 
@@ -155,30 +443,127 @@ typedef enum {
     let_ltarf,
     let_east,
     let_easf01,
-    let_easf02,
-    let_irms1,
+    let_easd01 = let_easf01+LINKY_INDEX_EASF,
+    let_eait = let_easd01+LINKY_INDEX_EASD,
+    let_erq1,
+    let_irms1 = let_erq1+LINKY_ERQ_COUNT,
     let_urms1,
     let_pref,
     let_sinsts,
     let_smaxsn,
     let_smaxsnm1,
+    let_sinsti,
+    let_smaxin,
+    let_smaxinm1,
     let_ccasn,
     let_ccasnm1,
+    let_ccain,
+    let_ccainm1,
     let_umoy1,
     let_stge,
     let_prm,
+    let_relais,
     let_ntarf,
-    let_hchp
+    let_njourf,
+    let_njourf1,
+    let_pjourf1,
+    let_hchp,
+    let_next,
+    let_power,
+    let_hhpower,
+    let_net,
+    let_count
 }
   linky_etiq_t;
 
+/* the validation statistics of a field
+ */
+typedef struct {
+    uint32_t    mean;                       /* scaled by 2^4 */
+    uint32_t    var;
+    uint8_t     count;                      /* count of accepted values, up to LINKY_STAT_WARMUP */
+    uint8_t     held;                       /* 1 if an out of band value above the mean is held, 2 if below, else 0 */
+    uint16_t    value;                      /* the held value */
+}
+  linky_stat_t;
+
+/* the classes of decode errors
+ */
+typedef enum {
+    ler_checksum = 0,                       // checksum error
+    ler_short,                              // group too short
+    ler_overflow,                           // group too long for the reception buffer
+    ler_invalid,                            // value rejected by the validator
+    ler_monotonic,                          // energy index lower than the previous one
+    ler_count
+}
+  linky_error_t;
+
+/* an entry of the ignored labels table
+ */
+typedef struct {
+    uint16_t    label;                      /* hash of the label, zero if the entry is free */
+    uint16_t    value;                      /* hash of the last sent value */
+    uint16_t    sent;                       /* time of the last report (min) */
+}
+  linky_ignored_t;
+
+/* a bit group of the STGE status register
+ */
+typedef struct {
+    uint8_t     shift;
+    uint8_t     width;
+    uint8_t     child;
+    char        label[LINKY_STGE_LABEL];
+}
+  linky_stge_t;
+
+/* the send queues, by priority order
+ */
+typedef enum {
+    lqu_alarm = 0,
+    lqu_value,
+    lqu_dump,
+    lqu_diag,
+    lqu_log,
+    lqu_count
+}
+  linky_queue_t;
+
+/* the diagnostic reports, queued on the controller requests
+ */
+typedef enum {
+    ldg_errors = 0,
+    ldg_timing,
+    ldg_queues,
+    ldg_histogram,
+    ldg_count
+}
+  linky_diag_t;
+
+/* the fixed text logs, by pairs of opposite events
+ */
+typedef enum {
+    llg_hp = 0,
+    llg_hc,
+    llg_shed_on,
+    llg_shed_off,
+    llg_count
+}
+  linky_log_t;
+
 /* bit position of the next step in the flag register
  *  this determines the next step to be done in the receiving loop
  */
 typedef enum {
     lst_Rec = 0,  // receive
     lst_RxB,      // receive in buffer B (rather than in buffer A)
-    lst_Dec       // decode
+    lst_Dec,      // decode
+    lst_Err,      // error in the current trame
+    lst_Idx,      // EAST validated in the current trame
+    lst_Val,      // a valid trame has been received
+    lst_Cp,       // checkpoint needed
+    lst_Etx       // commit the trame
 }
   linky_step_t;
 
@@ -186,21 +571,38 @@ class Linky
 {
     public:
                                   Linky( uint8_t id, uint8_t rxPin, uint8_t ledPin, uint8_t hcPin, uint8_t hpPin );
+        virtual void              errorsSend( void );
+        virtual void              histogramSend( uint8_t child );
+        virtual bool              isIdle( void );
         virtual void              ledOff( uint8_t pin );
         virtual void              ledOn( uint8_t pin );
         virtual void              loop();
         virtual bool              logIgnoredGet( void );
         virtual void              logIgnoredSet( bool status );
-        virtual void              present();
+        virtual bool              present();
+        virtual void              presentWait( void );
+        virtual void              queuesSend( void );
+        virtual void              resync( uint16_t since );
         virtual void              send( bool all=false );
+        virtual bool              sendMsg( MyMessage &msg );
+        virtual bool              sendReady( void );
+        virtual void              seqSend( void );
+        virtual void              setPeriods( uint32_t min_period_ms, uint32_t max_period_ms );
+        virtual void              setRules( const sRule *rules );
         virtual void              setup( uint32_t min_period_ms, uint32_t max_period_ms );
+        virtual void              timingSend( void );
 
     private:
         /* construction data
          *  Please note that the SoftwareSerial object requires to be constructed and initialized
          *  at the very same time that this object instance itself (see Linky() constructor).
+         *  When ICPSERIAL is defined, the Timer1 input capture port is used instead (see icpSerial.h).
          */
+#ifdef ICPSERIAL
+                icpSerial         linkySerial;
+#else
                 SoftwareSerial    linkySerial;
+#endif
                 uint8_t           id;
                 uint8_t           rxPin;
                 uint8_t           ledPin;
@@ -212,51 +614,203 @@ class Linky
                 char              _BfA[LINKY_BUFSIZE];      /* Buffer A */
                 char              _BfB[LINKY_BUFSIZE];      /* Buffer B */
                 uint8_t           _FR;                      /* Flag register */
-                uint32_t          _DNFR;                    /* Data new flag register */
+                uint8_t           _DNFR[( let_count+7 )/8]; /* Data new flag register */
                 char             *_pRec;                    /* Reception pointer in the buffer */
                 char             *_pDec;                    /* Decode pointer in the buffer */
                 char             *_startLabel;              /* the start of the label */
                 uint8_t           _iRec;                    /*  Received char index */
                 uint8_t           _iCks;                    /* Index of Cks in the received message */
+                uint8_t           _sRec;                    /* running sum of the received chars */
+                uint8_t           _iBlk;                    /* start of the current PJOURF+1 block, zero if none */
                 uint8_t           _GId;                     /* Group identification */
+                uint8_t           _rebase;                  /* count of consecutive EAST rejections */
+                uint8_t           _sent;                    /* count of messages sent in the current round */
+                uint8_t           _fails;                   /* count of messages which did not reach the gateway */
+                uint32_t          _stge;                    /* STGE bits changed since last report */
 
                 tic_t             tic;
                 uint32_t          stx_ms;
 
-                pwiTimer          min_period;
-                pwiTimer          max_period;
-                pwiTimer          timeout_timer;
+                // tariff schedule
+                uint16_t          sched[LINKY_SCHED_SIZE];  /* today's schedule */
+                uint8_t           sched_day;                /* day of the month of the last DATE */
+                bool              sched_seed;               /* today's schedule has been seeded from PJOURF+1 */
+                uint16_t          sched_hp;                 /* bit n set if index n is HP */
+                uint16_t          sched_known;              /* bit n set if the meaning of index n is known */
+                int8_t            ltarf_hp;                 /* LTARF of the current trame: 1 if HP, 0 if HC, -1 if unknown */
+
+                uint32_t          min_period_ms;            /* configured min period, floor of the adaptive one */
+                uint8_t           pace_ms;                  /* adaptive wait between two messages */
+                uint32_t          send_ms;                  /* millis() at the last sent message */
+                wheelTimer        min_period;
+                wheelTimer        max_period;
+                wheelTimer        timeout_timer;
+                wheelTimer        checkpoint_timer;
 
                 // because the LED is visible on the front panel, we choose to manage it with a hardware timer
-                pwiTimer          led_status_timer;         /* 3 sec if OK, 1 sec else */
-                pwiTimer          led_on_timer;             /* 0.1 sec */
+                wheelTimer        led_timer;                /* 150 ms on, then off until the end of the period */
+                uint16_t          led_period_ms;            /* 3 sec if OK, 1 sec else */
+
+                // validation
+                linky_stat_t      stat_irms1;
+                linky_stat_t      stat_urms1;
+                linky_stat_t      stat_sinsts;
+                uint8_t           cks_rate;                 /* exponential average of the checksum errors */
+
+                // decode errors
+                uint16_t          errors[ler_count];
+                char              bad[LINKY_BAD_COUNT][1+LINKY_BAD_SIZE];
+                uint8_t           bad_next;                 /* next slot of the bad ring */
+
+                // supplier messages: last decoded MSG1 and MSG2, hashes of the last sent ones
+                char              msg1[1+LINKY_MSG1_SIZE];
+                char              msg2[1+LINKY_MSG2_SIZE];
+                uint16_t          msg_hash[2];
+                uint8_t           msg_pend;                 /* bit n set if MSGn+1 is queued */
+                uint8_t           msg_fail;                 /* bit n set if a chunk of MSGn+1 failed */
+                uint8_t           msg_chunk[2];             /* next chunk to be sent */
+
+                // active power derivation
+                uint32_t          power_east;               /* EAST at the last increment */
+                uint32_t          power_s;                  /* second of the day of the last increment */
+                uint32_t          power_acc;                /* smoothed power << LINKY_POWER_SHIFT, NONE until seeded */
+                bool              producer;                 /* SINSTI has been received: the net power is derived */
+
+                // timing
+                uint32_t          first_ms;                 /* millis() at the first valid trame */
+                uint16_t          ifi_avg;                  /* interval between two STX (ms) */
+                uint16_t          ifi_max;
+                uint16_t          dur_avg;                  /* STX to ETX (ms) */
+                uint16_t          dur_max;
+                uint32_t          drift_ms;                 /* local time at the drift anchor */
+                uint32_t          drift_s;                  /* meter seconds since the drift anchor */
+                uint32_t          drift_sod;                /* second of the day of the last DATE */
+                int16_t           drift_ppm;
+                uint8_t           hh_slot;                  /* current half-hour of the day */
+                uint32_t          hh_east;                  /* EAST at the start of the half-hour */
+
+                // sizing histogram
+                uint8_t           hist_pref;                /* the PREF the counts are relative to, 0 until known */
+                uint16_t          hist_add[EEPROM_HISTOGRAM_SIZE];  /* counts since the last EEPROM write */
+                uint8_t           hist_every;               /* checkpoints since the last histogram write */
+
+                // energy accounting
+                char              energy_day[7];            /* YYMMDD of the current day, empty if unknown */
+                uint32_t          energy_s;                 /* second of the day of the last update */
+                uint8_t           energy_day_base[LINKY_ENERGY_COUNT][3];   /* day snapshot, low 24 bits */
+                uint32_t          energy_base[LINKY_ENERGY_COUNT];  /* month snapshot */
+                uint8_t           energy_exact;             /* bit n set if the snapshot n has been taken on the boundary */
+                char              energy_closed[7];         /* YYMMDD of the last closed day */
+                uint32_t          energy_close[LINKY_ENERGY_COUNT]; /* indexes at the last boundary */
+                uint16_t          energy_pend;              /* bit 8*period+i set if the closed increment i is queued */
+
+                // send queues
+                uint8_t           _PEND[( let_count+7 )/8]; /* fields queued as changed values */
+                uint32_t          _stge_pend;               /* STGE bits queued as alarms or changed values */
+                uint8_t           dump_next;                /* next item of the full report */
+                uint8_t           log_pend;                 /* bit n set if the linky_log_t n is queued */
+                char              log_text[1+LINKY_LOG_SIZE];   /* queued ignored label log, empty if none */
+                uint8_t           diag_pend;                /* bit n set if the linky_diag_t n is queued */
+                uint8_t           diag_cur;                 /* report being sent, ldg_count if none */
+                uint8_t           diag_next;                /* next item of the report being sent */
+                uint8_t           diag_child;               /* child of the histogram report */
+                uint32_t          q_since[lqu_count];       /* millis() when the queue was last found empty */
+                uint16_t          q_sent[lqu_count];
+                uint8_t           q_depth[lqu_count];       /* max count of pending items (deferred logs) */
+                uint16_t          q_lat[lqu_count];         /* max enqueue to send (ms) */
+
+                // incremental resync
+                uint16_t          seq;                      /* sequence number of the last committed trame */
+                uint16_t          seq_count;                /* committed trames since the sequence start, up to LINKY_SEQ_WINDOW */
+                uint16_t          seq_ack;                  /* queued sequence number, taken when first queued */
+                bool              seq_pend;                 /* whether the sequence number is queued */
+                uint8_t           chg_epoch[( let_count+1 )/2]; /* epoch of the last change of each field, by nibbles */
+
+                // load shedding rules
+                sRule             rules[EEPROM_RULES];
+                uint8_t           rules_count[EEPROM_RULES];/* consecutive trames on the other side of the threshold */
+                uint8_t           rules_on;                 /* bit n set if the pin of rule n is set */
 
                 // whether we want log ignored information groups
                 bool              log_ignored;
+                linky_ignored_t   ignored[LINKY_IGNORED_SIZE];
 
         /* private methods
          */
                 void              init();
+#ifdef LINKY_CAPTURE
+                void              capture( char c );
+#endif
                 void              init_led( uint8_t *dest, uint8_t pin );
+                void              checkpoint( void );
                 bool              checkHorodate( const char *p );
+                void              decError( linky_error_t err, const char *label, const char *value );
+                uint8_t           diagCount( uint8_t report );
+                void              diagQueue( uint8_t report );
+                void              energyBase( uint8_t period, uint8_t i, uint32_t index );
+                void              energyClose( bool month );
+                uint32_t          energyIndex( uint8_t i );
+                uint32_t          energySince( uint8_t period, uint8_t i, uint32_t index );
+                void              energyUpdate( void );
+                bool              errorsItem( uint8_t item );
                 bool              decData( char *dest, linky_etiq_t etiq );
                 bool              decData( horodate_t *dest, linky_etiq_t etiq );
                 bool              decData( uint8_t *dest, linky_etiq_t etiq );
                 bool              decData( uint16_t *dest, linky_etiq_t etiq );
                 bool              decData( uint32_t *dest, linky_etiq_t etiq );
+                bool              decInvalid( linky_etiq_t etiq );
+                bool              decSchedule( uint16_t *dest, linky_etiq_t etiq );
+                void              decMessage( uint8_t i );
+                bool              decStatus( uint32_t *dest, linky_etiq_t etiq );
+                void              hchpSet( bool hchp );
+                bool              histogramItem( uint8_t item );
+                void              histogramTotal( sHistogram &hist );
+                void              histogramUpdate( void );
+                uint32_t          horodateStamp( const char *p );
+                uint16_t          ig_block( const char *p );
+                void              ig_commit( void );
                 bool              ig_checksum( void );
+                uint8_t           indexFind( const char *label );
+                char             *indexLabel( uint8_t idx, char *buffer );
                 void              ig_decode( void );
+                void              ig_process( void );
                 void              ig_receive( void );
                 void              logIgnored();
-                void              sendLog( char *msg );
+                void              logQueue( uint8_t log );
+                void              netUpdate( void );
+                void              pace( void );
+                void              queueAdded( uint8_t queue, uint8_t before );
+                uint8_t           queueDepth( uint8_t queue );
+                void              queueSent( uint8_t queue );
+                bool              queuesEmpty( void );
+                bool              queuesItem( uint8_t item );
+                uint32_t          dateSeconds( void );
+                void              powerUpdate( void );
+                void              rulesApply( void );
+                void              scheduleDay( void );
+                void              scheduleUpdate( void );
+                void              seqStart( uint16_t seq );
+                void              seqUpdate( void );
+                void              sendClosed( uint8_t n );
+                bool              sendEnergy( uint8_t i );
+                bool              sendEtiq( uint8_t etiq, bool all );
+                void              sendGroup( uint8_t i );
+                void              sendDiag( void );
+                void              sendLog( const char *text );
+                void              sendMessage( uint8_t i );
+                void              sendNext( void );
+                void              sendSeq( uint16_t seq );
+                bool              timingItem( uint8_t item );
+                void              timingUpdate( void );
                 void              trameLedSet( uint32_t period_ms );
+                bool              validate( linky_stat_t *stat, uint16_t value, uint16_t dev );
 
         /* static methods
          */
+        static  void              CheckpointCb( void *user_data );
         static  void              MaxPeriodCb( void *user_data );
         static  void              MinPeriodCb( void *user_data );
-        static  void              TrameLedOnCb( void *data );
-        static  void              TrameLedStatusCb( void *data );
+        static  void              TrameLedCb( void *data );
         static  void              TrameTimeoutCb( void *data );
 };
   
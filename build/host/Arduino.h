@@ -0,0 +1,85 @@
+/* **********************************************************************************************************
+ * A minimal Arduino.h for the host tests of build/: millis() is driven by the test.
+ * As on the AVR, millis() is 32 bits, so that the tests may exercise its wrap.
+ * The PROGMEM accessors read the SRAM, the pins and the debug serial port do nothing.
+ *
+ * pwi 2026-10-18 v1 creation
+ * pwi 2026-10-18 v2 add what the Linky class needs
+ */
+#ifndef __HOST_ARDUINO_H__
+#define __HOST_ARDUINO_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+extern uint32_t host_ms;
+
+static inline uint32_t millis( void ) { return( host_ms ); }
+static inline uint32_t micros( void ) { return( host_ms*1000UL ); }
+
+#define PROGMEM
+#define F( s )                  ( s )
+#define PSTR( s )               ( s )
+#define pgm_read_byte( p )      ( *( const uint8_t * )( p ))
+#define pgm_read_word( p )      ( *( const uintptr_t * )( p ))
+#define strcpy_P                strcpy
+#define strcmp_P                strcmp
+#define strncmp_P               strncmp
+#define strstr_P                strstr
+#define strlen_P                strlen
+#define memcpy_P                memcpy
+
+#define bitRead( v, b )         ((( v ) >> ( b )) & 1 )
+#define bitSet( v, b )          (( v ) |= ( 1UL << ( b )))
+#define bitClear( v, b )        (( v ) &= ~( 1UL << ( b )))
+#define bitWrite( v, b, x )     (( x ) ? bitSet( v, b ) : bitClear( v, b ))
+
+#define LOW                     0
+#define HIGH                    1
+#define INPUT                   0
+#define OUTPUT                  1
+#define HEX                     16
+#define DEC                     10
+
+static inline void pinMode( uint8_t, uint8_t ) {}
+static inline void digitalWrite( uint8_t, uint8_t ) {}
+
+static inline char *ultoa( unsigned long v, char *buf, int radix ) { sprintf( buf, radix == 16 ? "%lx" : "%lu", v ); return( buf ); }
+static inline char *utoa( unsigned v, char *buf, int radix ) { return( ultoa( v, buf, radix )); }
+static inline char *ltoa( long v, char *buf, int ) { sprintf( buf, "%ld", v ); return( buf ); }
+static inline char *itoa( int v, char *buf, int radix ) { return( ltoa( v, buf, radix )); }
+
+class String
+{
+    public:
+                    String( const char *str ) { snprintf( this->s, sizeof( this->s ), "%s", str ); }
+        const char *c_str( void ) const { return( this->s ); }
+        void        trim( void ) {
+                        size_t len = strlen( this->s );
+                        while( len && isspace( this->s[len-1] )){ this->s[--len] = '\0'; }
+                        size_t start = strspn( this->s, " \t\r\n" );
+                        memmove( this->s, this->s+start, len-start+1 );
+                    }
+    private:
+        char        s[128];
+};
+
+class HostSerial
+{
+    public:
+        void begin( long ) {}
+        template<class T> void print( T ) {}
+        template<class T> void print( T, int ) {}
+        template<class T> void println( T ) {}
+        template<class T> void println( T, int ) {}
+        void println( void ) {}
+        void write( uint8_t ) {}
+};
+
+extern HostSerial Serial;
+
+#endif // __HOST_ARDUINO_H__
@@ -0,0 +1,42 @@
+/* **********************************************************************************************************
+ * A SoftwareSerial for the host tests of build/: the test pushes the received characters in a ring of
+ * the same 64 bytes as the AVR one, the characters received while it is full being dropped.
+ *
+ * pwi 2026-10-18 v1 creation
+ */
+#ifndef __HOST_SOFTWARESERIAL_H__
+#define __HOST_SOFTWARESERIAL_H__
+
+#include <Arduino.h>
+
+#define HOST_SERIAL_BUFSIZE     64
+
+class SoftwareSerial
+{
+    public:
+                            SoftwareSerial( uint8_t, uint8_t ) {}
+                void        begin( long ) {}
+                int         available( void ) { return(( uint8_t )( st_head+HOST_SERIAL_BUFSIZE-st_tail ) % HOST_SERIAL_BUFSIZE ); }
+                int         read( void ) {
+                                if( st_head == st_tail ){ return( -1 ); }
+                                uint8_t c = st_buffer[st_tail];
+                                st_tail = ( st_tail+1 ) % HOST_SERIAL_BUFSIZE;
+                                return( c );
+                            }
+
+        /* called by the test on each received character, returns false if it has been dropped */
+        static  bool        Receive( uint8_t c ) {
+                                uint8_t next = ( st_head+1 ) % HOST_SERIAL_BUFSIZE;
+                                if( next == st_tail ){ return( false ); }
+                                st_buffer[st_head] = c;
+                                st_head = next;
+                                return( true );
+                            }
+
+    private:
+        static  uint8_t     st_buffer[HOST_SERIAL_BUFSIZE];
+        static  uint8_t     st_head;
+        static  uint8_t     st_tail;
+};
+
+#endif // __HOST_SOFTWARESERIAL_H__
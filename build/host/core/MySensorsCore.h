@@ -0,0 +1,43 @@
+/* **********************************************************************************************************
+ * A minimal MySensors core for the host tests of build/: the transport is provided by the test.
+ *
+ * pwi 2026-10-18 v1 creation
+ */
+#ifndef __HOST_MYSENSORSCORE_H__
+#define __HOST_MYSENSORSCORE_H__
+
+#include <Arduino.h>
+
+#define MAX_PAYLOAD             25
+
+enum { S_BINARY = 3, S_POWER = 13, S_MULTIMETER = 30, S_INFO = 36 };
+enum { V_STATUS = 2, V_WATT = 17, V_KWH = 18, V_VA = 23, V_VOLTAGE = 38, V_CURRENT = 39, V_TEXT = 47 };
+
+class MyMessage
+{
+    public:
+        uint8_t     sensor;
+        uint8_t     type;
+        char        data[MAX_PAYLOAD+8];
+
+                    MyMessage() { this->clear(); }
+        MyMessage  &clear( void ) { this->sensor = 0; this->type = 0; this->data[0] = '\0'; return( *this ); }
+        MyMessage  &setSensor( uint8_t sensor ) { this->sensor = sensor; return( *this ); }
+        MyMessage  &setType( uint8_t type ) { this->type = type; return( *this ); }
+        MyMessage  &set( const char *value ) { snprintf( this->data, sizeof( this->data ), "%s", value ); return( *this ); }
+        MyMessage  &set( float value, uint8_t decimals ) { snprintf( this->data, sizeof( this->data ), "%.*f", decimals, value ); return( *this ); }
+        MyMessage  &set( bool value ) { return( this->set(( uint32_t ) value )); }
+        MyMessage  &set( uint8_t value ) { return( this->set(( uint32_t ) value )); }
+        MyMessage  &set( uint16_t value ) { return( this->set(( uint32_t ) value )); }
+        MyMessage  &set( uint32_t value ) { snprintf( this->data, sizeof( this->data ), "%lu", ( unsigned long ) value ); return( *this ); }
+        MyMessage  &set( int16_t value ) { return( this->set(( int32_t ) value )); }
+        MyMessage  &set( int32_t value ) { snprintf( this->data, sizeof( this->data ), "%ld", ( long ) value ); return( *this ); }
+};
+
+bool    send( MyMessage &msg, const bool echo=false );
+bool    present( const uint8_t child, const uint8_t type, const char *description="", const bool ack=false );
+void    wait( const uint32_t ms );
+uint8_t loadState( const uint8_t pos );
+void    saveState( const uint8_t pos, const uint8_t value );
+
+#endif // __HOST_MYSENSORSCORE_H__
@@ -0,0 +1,11 @@
+/* **********************************************************************************************************
+ * The subset of pwiCommon.h used by the Linky class, for the host tests of build/.
+ *
+ * pwi 2026-10-18 v1 creation
+ */
+#ifndef __HOST_PWICOMMON_H__
+#define __HOST_PWICOMMON_H__
+
+#define PGMSTR( s )             ( s )
+
+#endif // __HOST_PWICOMMON_H__
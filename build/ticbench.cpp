@@ -0,0 +1,323 @@
+/* **********************************************************************************************************
+ * Host bench of the Linky class: a synthetic standard TIC stream is received at 9600 bauds (960 chars/s)
+ * through the same 64 bytes ring than SoftwareSerial, while the messages go through a simulated transport
+ * which blocks the node for a given latency on each send (as the radio ack does):
+ *   g++ -I build/host -I . -o ticbench build/ticbench.cpp Linky.cpp eeprom.cpp wheelTimer.cpp && ./ticbench
+ *
+ * Options:
+ *   -d <s>      simulated duration (default 900 s)
+ *   -l <ms>     transport latency of a send or a presentation (default 6 ms)
+ *   -f <n>      one send out of n fails (default 0: none)
+ *   -c <us>     duration of a loop() call (default 200 us)
+ *   -s <date>   meter DATE of the first trame (default H260131235500)
+ *   -p          send the presentation from the boot (as when the build has changed)
+ *   -i          producer meter which has not injected anything yet (EAIT, ERQ1..ERQ4 and SINSTI are zero)
+ *   -v          print each sent message
+ *
+ * The meter sends a trame every 2 s from 0.5 s after the boot, the chars of a trame being back to back,
+ * which is the worst case for the ring. SINSTS steps from 600 to 5200 VA after 5 min for 5 min, and the default DATE crosses a day
+ * and a month 5 min after the start. A closed day is only reported after a full day (e.g. -d 87000).
+ *
+ * Reported: the received and lost chars, the max interval between two loop() calls, the time from the
+ * boot to the first TIC value, the closed periods, and the errors, queues and timing reports of the node,
+ * requested at the end of the run.
+ *
+ * This is not a cycle-accurate simulation of the ATmega328P: the decoding takes no time, and the
+ * interrupts are not simulated (see TODO #6).
+ *
+ * pwi 2026-10-18 v1 creation
+ */
+#include <unistd.h>
+#include <string>
+#include <core/MySensorsCore.h>
+#include "childids.h"
+#include "Linky.h"
+
+#define BENCH_TRAME_MS          2000
+#define BENCH_CHAR_US           1042    /* 10 bits at 9600 bauds */
+#define BENCH_PHASE_US          500000  /* first STX after the boot, the meter not being in phase with it */
+#define BENCH_STEP_S            300
+#define BENCH_STEP_LEN_S        300
+
+uint32_t   host_ms = 0;
+HostSerial Serial;
+
+uint8_t    SoftwareSerial::st_buffer[HOST_SERIAL_BUFSIZE];
+uint8_t    SoftwareSerial::st_head = 0;
+uint8_t    SoftwareSerial::st_tail = 0;
+
+static uint64_t    st_us = 0;                   /* simulated time */
+static uint32_t    st_latency_ms = 6;
+static uint32_t    st_fail_every = 0;
+static bool        st_verbose = false;
+static bool        st_producer = false;
+static uint8_t     st_eeprom[256];
+
+/* the meter */
+static char        st_date[14];                 /* current DATE horodate */
+static uint32_t    st_trame_s = 0;              /* meter seconds since the first trame */
+static double      st_east = 20240587.0;
+static double      st_easf02 = 12176090.0;
+static std::string st_trame;
+static size_t      st_pos = 0;
+static uint64_t    st_next_char_us = BENCH_PHASE_US;
+static uint64_t    st_next_trame_us = BENCH_PHASE_US;
+
+/* the metrics */
+static uint32_t    st_trames = 0;
+static uint32_t    st_chars = 0;
+static uint32_t    st_lost = 0;
+static uint32_t    st_sends = 0;
+static uint32_t    st_fails = 0;
+static uint32_t    st_first_ms = 0;
+static uint32_t    st_gap_max_ms = 0;
+
+/**
+ * benchGroup:
+ *
+ * Append an information group, with its checksum computed as in the standard mode.
+ */
+static void benchGroup( std::string &out, const char *label, const char *value, const char *date=NULL )
+{
+    std::string zone = std::string( label )+"\t";
+    if( date ){
+        zone += std::string( date )+"\t";
+    }
+    zone += std::string( value )+"\t";
+    unsigned sum = 0;
+    for( size_t i=0 ; i<zone.size() ; ++i ){
+        sum += ( uint8_t ) zone[i];
+    }
+    out += "\n"+zone+( char )(( sum & 0x3f )+0x20 )+"\r";
+}
+
+/**
+ * benchDateAdvance:
+ *
+ * Advance the YYMMDDhhmmss part of the horodate by one second.
+ */
+static void benchDateAdvance( char *date )
+{
+    static const uint8_t days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    int f[6];
+    for( int i=0 ; i<6 ; ++i ){
+        f[i] = 10*( date[1+2*i]-'0' )+( date[2+2*i]-'0' );
+    }
+    int mdays = days[f[1]-1]+( f[1] == 2 && f[0] % 4 == 0 ? 1 : 0 );
+    if( ++f[5] == 60 ){ f[5] = 0;
+        if( ++f[4] == 60 ){ f[4] = 0;
+            if( ++f[3] == 24 ){ f[3] = 0;
+                if( ++f[2] > mdays ){ f[2] = 1;
+                    if( ++f[1] > 12 ){ f[1] = 1; f[0] += 1; }
+                }
+            }
+        }
+    }
+    for( int i=0 ; i<6 ; ++i ){
+        date[1+2*i] = '0'+f[i]/10;
+        date[2+2*i] = '0'+f[i]%10;
+    }
+}
+
+/**
+ * benchTrame:
+ *
+ * Build the next trame, after BENCH_TRAME_MS of meter time.
+ */
+static void benchTrame( void )
+{
+    char buf[32];
+    if( st_trames ){
+        for( int i=0 ; i<BENCH_TRAME_MS/1000 ; ++i ){
+            benchDateAdvance( st_date );
+        }
+        st_trame_s += BENCH_TRAME_MS/1000;
+    }
+    bool step = ( st_trame_s >= BENCH_STEP_S && st_trame_s < BENCH_STEP_S+BENCH_STEP_LEN_S );
+    unsigned sinsts = ( step ? 5200 : 600 )+( st_trames % 7 )*5;
+    st_east += sinsts*( BENCH_TRAME_MS/3600000.0 );
+    st_easf02 += sinsts*( BENCH_TRAME_MS/3600000.0 );
+
+    st_trame = "\x02";
+    benchGroup( st_trame, "ADSC", "031861360149" );
+    benchGroup( st_trame, "VTIC", "02" );
+    benchGroup( st_trame, "DATE", "", st_date );
+    benchGroup( st_trame, "NGTF", "H PLEINE/CREUSE " );
+    benchGroup( st_trame, "LTARF", "  HEURE  PLEINE " );
+    snprintf( buf, sizeof( buf ), "%09lu", ( unsigned long ) st_east );
+    benchGroup( st_trame, "EAST", buf );
+    benchGroup( st_trame, "EASF01", "008064497" );
+    snprintf( buf, sizeof( buf ), "%09lu", ( unsigned long ) st_easf02 );
+    benchGroup( st_trame, "EASF02", buf );
+    for( int i=3 ; i<=10 ; ++i ){
+        snprintf( buf, sizeof( buf ), "EASF%02d", i );
+        benchGroup( st_trame, buf, "000000000" );
+    }
+    benchGroup( st_trame, "EASD01", "008064497" );
+    snprintf( buf, sizeof( buf ), "%09lu", ( unsigned long ) st_easf02 );
+    benchGroup( st_trame, "EASD02", buf );
+    benchGroup( st_trame, "EASD03", "000000000" );
+    benchGroup( st_trame, "EASD04", "000000000" );
+    if( st_producer ){
+        benchGroup( st_trame, "EAIT", "000000000" );
+        for( int i=1 ; i<=4 ; ++i ){
+            snprintf( buf, sizeof( buf ), "ERQ%d", i );
+            benchGroup( st_trame, buf, "000000000" );
+        }
+    }
+    snprintf( buf, sizeof( buf ), "%03u", ( sinsts+115 )/230 );
+    benchGroup( st_trame, "IRMS1", buf );
+    snprintf( buf, sizeof( buf ), "%03u", 230+st_trames % 3 );
+    benchGroup( st_trame, "URMS1", buf );
+    benchGroup( st_trame, "PREF", "12" );
+    benchGroup( st_trame, "PCOUP", "12" );
+    snprintf( buf, sizeof( buf ), "%05u", sinsts );
+    benchGroup( st_trame, "SINSTS", buf );
+    if( st_producer ){
+        benchGroup( st_trame, "SINSTI", "00000" );
+    }
+    benchGroup( st_trame, "SMAXSN", "05529", "H260131003225" );
+    benchGroup( st_trame, "SMAXSN-1", "05473", "H260130234801" );
+    benchGroup( st_trame, "CCASN", "03073", "H260131170000" );
+    benchGroup( st_trame, "CCASN-1", "01710", "H260131160000" );
+    benchGroup( st_trame, "UMOY1", "230", "H260131173000" );
+    benchGroup( st_trame, "STGE", "003A4401" );
+    benchGroup( st_trame, "MSG1", "PAS DE          MESSAGE         " );
+    benchGroup( st_trame, "PRM", "16136758172204" );
+    benchGroup( st_trame, "RELAIS", "000" );
+    benchGroup( st_trame, "NTARF", "02" );
+    benchGroup( st_trame, "NJOURF", "00" );
+    benchGroup( st_trame, "NJOURF+1", "00" );
+    benchGroup( st_trame, "PJOURF+1", "0000C001 06208002 2220C001 NONUTILE NONUTILE NONUTILE NONUTILE NONUTILE NONUTILE NONUTILE NONUTILE" );
+    st_trame += "\x03";
+    st_pos = 0;
+    st_trames += 1;
+}
+
+/**
+ * benchAdvance:
+ *
+ * Let the time go by @us, the TIC chars being received in the ring meanwhile.
+ */
+static void benchAdvance( uint64_t us )
+{
+    uint64_t end = st_us+us;
+    while( st_next_char_us <= end ){
+        st_us = st_next_char_us;
+        host_ms = st_us/1000;
+        if( st_pos >= st_trame.size()){
+            if( st_us < st_next_trame_us ){
+                st_next_char_us = st_next_trame_us;
+                continue;
+            }
+            benchTrame();
+            st_next_trame_us = st_us+1000ULL*BENCH_TRAME_MS;
+        }
+        st_chars += 1;
+        if( !SoftwareSerial::Receive( st_trame[st_pos++] )){
+            st_lost += 1;
+        }
+        st_next_char_us = st_us+BENCH_CHAR_US;
+    }
+    st_us = end;
+    host_ms = st_us/1000;
+}
+
+/* the simulated MySensors core
+ */
+bool send( MyMessage &msg, const bool )
+{
+    benchAdvance( 1000ULL*st_latency_ms );
+    st_sends += 1;
+    bool ok = !( st_fail_every && st_sends % st_fail_every == 0 );
+    if( !ok ){
+        st_fails += 1;
+    }
+    if( !st_first_ms && msg.sensor >= CHILD_TI && msg.sensor < CHILD_STGE ){
+        st_first_ms = host_ms;
+    }
+    bool report = ( msg.sensor == CHILD_ID_ERRORS || msg.sensor == CHILD_ID_QUEUES || msg.sensor == CHILD_ID_TIMING
+            || msg.sensor == CHILD_ID_ENERGY_DAY_CLOSED || msg.sensor == CHILD_ID_ENERGY_MONTH_CLOSED );
+    if( st_verbose || report ){
+        printf( "%9lu send child=%u type=%u '%s'%s\n", ( unsigned long ) host_ms, msg.sensor, msg.type, msg.data, ok ? "" : " failed" );
+    }
+    return( ok );
+}
+
+bool present( const uint8_t, const uint8_t, const char *, const bool )
+{
+    benchAdvance( 1000ULL*st_latency_ms );
+    return( true );
+}
+
+void wait( const uint32_t ms )
+{
+    benchAdvance( 1000ULL*ms );
+}
+
+uint8_t loadState( const uint8_t pos )
+{
+    return( st_eeprom[pos] );
+}
+
+void saveState( const uint8_t pos, const uint8_t value )
+{
+    st_eeprom[pos] = value;
+}
+
+int main( int argc, char **argv )
+{
+    uint32_t duration_s = 900;
+    uint32_t loop_us = 200;
+    bool presentation = false;
+    int opt;
+
+    strcpy( st_date, "H260131235500" );
+    while(( opt = getopt( argc, argv, "d:l:f:c:s:piv" )) != -1 ){
+        switch( opt ){
+            case 'd': duration_s = atol( optarg ); break;
+            case 'l': st_latency_ms = atol( optarg ); break;
+            case 'f': st_fail_every = atol( optarg ); break;
+            case 'c': loop_us = atol( optarg ); break;
+            case 's': snprintf( st_date, sizeof( st_date ), "%s", optarg ); break;
+            case 'p': presentation = true; break;
+            case 'i': st_producer = true; break;
+            case 'v': st_verbose = true; break;
+            default:
+                fprintf( stderr, "Usage: %s [-d s] [-l ms] [-f n] [-c us] [-s date] [-p] [-i] [-v]\n", argv[0] );
+                return( 1 );
+        }
+    }
+    memset( st_eeprom, 0xff, sizeof( st_eeprom ));
+
+    /* as the sketch: the TIC is received from before(), then the presentation, then loop() */
+    static Linky linky( 1, 4, 5, 6, 7 );
+    linky.setup( 10000, 3600000 );
+    if( presentation ){
+        linky.present();
+    }
+    uint64_t end_us = 1000000ULL*duration_s;
+    uint64_t last_us = st_us;
+    bool requested = false;
+    while( st_us < end_us+5000000ULL ){
+        if( !requested && st_us >= end_us ){
+            linky.errorsSend();
+            linky.queuesSend();
+            linky.timingSend();
+            requested = true;
+        }
+        uint32_t gap = ( st_us-last_us )/1000;
+        if( gap > st_gap_max_ms ){
+            st_gap_max_ms = gap;
+        }
+        last_us = st_us;
+        wheelTimer::Loop();
+        linky.loop();
+        benchAdvance( loop_us );
+    }
+
+    printf( "trames=%lu chars=%lu lost=%lu\n", ( unsigned long ) st_trames, ( unsigned long ) st_chars, ( unsigned long ) st_lost );
+    printf( "sends=%lu failed=%lu loop_gap_max=%lu ms first_value=%lu ms\n", ( unsigned long ) st_sends, ( unsigned long ) st_fails,
+            ( unsigned long ) st_gap_max_ms, ( unsigned long ) st_first_ms );
+    return( 0 );
+}
@@ -0,0 +1,185 @@
+#!/usr/bin/perl -w
+# Store a raw TIC capture (see LINKY_CAPTURE in Linky.h) in an indexed, block-compressed capture file,
+# and read it back.
+#
+# The capture stream is read from the debug serial port of the node, e.g.:
+#   stty -F /dev/ttyUSB0 115200 raw && cat /dev/ttyUSB0 | ticcapture.pl -c tic.ticc -
+# The bytes without their high bit set are the debug outputs, and are dropped. Each trame is kept from
+# STX to ETX included, with the node millis() of its STX; a trame without ETX is dropped.
+#
+# Capture file (all integers are little endian):
+#   header   'TICC', u16 version, u16 trames per block, u64 capture time (host epoch s)
+#   blocks   zlib-compressed trame records: u32 millis, u16 length, the trame bytes
+#   index    one 32 bytes entry per block: u64 offset, u32 compressed length, u32 length,
+#            u32 count of trames, u32 first millis, u32 last millis, u32 number of the first trame
+#   trailer  u64 index offset, u32 count of blocks, 'TICI'
+# The index and the trailer are fixed-size records, so that a reader may map the file and only inflate
+# the blocks which cover the searched time.
+#
+# Usage:
+#   ticcapture.pl -c <capture.ticc> [<stream>]      create from a stream (default: stdin)
+#   ticcapture.pl -l <capture.ticc>                 list the blocks
+#   ticcapture.pl -x <capture.ticc> [<from> [<to>]] extract the raw trames whose millis are in [from,to]
+#                                                   on stdout, to be played as the ticstream.pl output
+#
+use strict;
+use warnings;
+use Compress::Zlib;
+
+my $VERSION = 1;
+my $BLOCK = 64;			# trames per block
+
+sub usage {
+	print STDERR "Usage: ".$0." -c <capture> [<stream>]\n";
+	print STDERR "       ".$0." -l <capture>\n";
+	print STDERR "       ".$0." -x <capture> [<from_ms> [<to_ms>]]\n";
+	exit 1;
+}
+
+usage() if scalar @ARGV < 2;
+my $mode = shift @ARGV;
+my $file = shift @ARGV;
+
+if( $mode eq '-c' ){
+	usage() if scalar @ARGV > 1;
+	create( $file, scalar @ARGV ? $ARGV[0] : '-' );
+} elsif( $mode eq '-l' ){
+	usage() if scalar @ARGV;
+	list( $file );
+} elsif( $mode eq '-x' ){
+	usage() if scalar @ARGV > 2;
+	extract( $file, scalar @ARGV > 0 ? $ARGV[0] : 0, scalar @ARGV > 1 ? $ARGV[1] : 0xffffffff );
+} else {
+	usage();
+}
+exit 0;
+
+# parse the capture stream, and write the capture file
+sub create {
+	my ( $file, $stream ) = @_;
+	my $in;
+	if( $stream eq '-' ){
+		$in = \*STDIN;
+	} else {
+		open( $in, '<', $stream ) or die "$stream: $!\n";
+	}
+	binmode( $in );
+	open( my $out, '>', $file ) or die "$file: $!\n";
+	binmode( $out );
+	print $out pack( 'a4 v v Q<', 'TICC', $VERSION, $BLOCK, time());
+
+	# a stream from a serial port never ends: terminate the file on ^C
+	my $stop = 0;
+	local $SIG{INT} = sub { $stop = 1; };
+
+	my @index = ();
+	my @block = ();
+	my ( $trame, $ts, $tsn, $count, $dropped ) = ( undef, 0, 0, 0, 0 );
+	my $buf;
+	while( !$stop && sysread( $in, $buf, 4096 )){
+		foreach my $b ( unpack( 'C*', $buf )){
+			next unless $b & 0x80;
+			$b &= 0x7f;
+			# the millis() groups follow the STX, and may take any 7 bits value
+			if( $tsn ){
+				$ts |= $b << ( 7*( 5-$tsn ));
+				$tsn -= 1;
+				$ts &= 0xffffffff if !$tsn;
+			} elsif( $b == 0x02 ){
+				$dropped += 1 if defined $trame;
+				$trame = chr( $b );
+				( $ts, $tsn ) = ( 0, 5 );
+			} elsif( defined $trame ){
+				$trame .= chr( $b );
+				if( $b == 0x03 ){
+					push( @block, [ $ts, $trame ] );
+					$trame = undef;
+					$count += 1;
+					if( scalar @block == $BLOCK ){
+						push( @index, flush( $out, \@block, $count-scalar @block ));
+					}
+				}
+			}
+		}
+	}
+	push( @index, flush( $out, \@block, $count-scalar @block )) if scalar @block;
+
+	my $offset = tell( $out );
+	print $out pack( 'Q< V V V V V V', @$_ ) for @index;
+	print $out pack( 'Q< V a4', $offset, scalar @index, 'TICI' );
+	close( $out );
+	print STDERR "$file: $count trame(s) in ".scalar( @index )." block(s), $dropped incomplete trame(s) dropped\n";
+}
+
+# compress and write a block, returning its index entry
+sub flush {
+	my ( $out, $block, $first ) = @_;
+	my $data = '';
+	$data .= pack( 'V v', $_->[0], length( $_->[1] )).$_->[1] for @$block;
+	my $z = compress( $data, Z_BEST_COMPRESSION );
+	my @entry = ( tell( $out ), length( $z ), length( $data ), scalar @$block, $block->[0][0], $block->[-1][0], $first );
+	print $out $z;
+	@$block = ();
+	return \@entry;
+}
+
+# read the header and the index
+sub open_capture {
+	my ( $file ) = @_;
+	open( my $fh, '<', $file ) or die "$file: $!\n";
+	binmode( $fh );
+	my $buf;
+	read( $fh, $buf, 16 ) == 16 or die "$file: truncated\n";
+	my ( $magic, $version, $block, $time ) = unpack( 'a4 v v Q<', $buf );
+	die "$file: not a capture file\n" if $magic ne 'TICC';
+	die "$file: unsupported version $version\n" if $version != $VERSION;
+	seek( $fh, -16, 2 ) or die "$file: $!\n";
+	read( $fh, $buf, 16 ) == 16 or die "$file: truncated\n";
+	my ( $offset, $count, $tail ) = unpack( 'Q< V a4', $buf );
+	die "$file: no index (interrupted capture?)\n" if $tail ne 'TICI';
+	seek( $fh, $offset, 0 ) or die "$file: $!\n";
+	read( $fh, $buf, 32*$count ) == 32*$count or die "$file: truncated index\n";
+	my @index = ();
+	push( @index, [ unpack( 'Q< V V V V V V', substr( $buf, 32*$_, 32 )) ] ) for 0 .. $count-1;
+	return ( $fh, $time, \@index );
+}
+
+sub list {
+	my ( $file ) = @_;
+	my ( $fh, $time, $index ) = open_capture( $file );
+	print "$file: captured on ".localtime( $time ).", ".scalar( @$index )." block(s)\n";
+	print "block  first trame  trames  from_ms     to_ms       offset    size    ratio\n";
+	my $i = 0;
+	foreach my $e ( @$index ){
+		printf( "%5u  %11u  %6u  %10u  %10u  %8u  %6u  %4.1f%%\n",
+			$i++, $e->[6], $e->[3], $e->[4], $e->[5], $e->[0], $e->[1], 100*$e->[1]/$e->[2] );
+	}
+	close( $fh );
+}
+
+# only the blocks which overlap the range are read and inflated
+sub extract {
+	my ( $file, $from, $to ) = @_;
+	my ( $fh, $time, $index ) = open_capture( $file );
+	binmode( STDOUT );
+	my $count = 0;
+	foreach my $e ( @$index ){
+		next if $e->[5] < $from || $e->[4] > $to;
+		my $z;
+		seek( $fh, $e->[0], 0 ) or die "$file: $!\n";
+		read( $fh, $z, $e->[1] ) == $e->[1] or die "$file: truncated block\n";
+		my $data = uncompress( $z );
+		die "$file: corrupted block at ".$e->[0]."\n" if !defined $data || length( $data ) != $e->[2];
+		my $pos = 0;
+		while( $pos < length( $data )){
+			my ( $ts, $len ) = unpack( 'V v', substr( $data, $pos, 6 ));
+			if( $ts >= $from && $ts <= $to ){
+				print substr( $data, $pos+6, $len );
+				$count += 1;
+			}
+			$pos += 6+$len;
+		}
+	}
+	close( $fh );
+	print STDERR "$count trame(s)\n";
+}
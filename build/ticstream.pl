@@ -0,0 +1,47 @@
+#!/usr/bin/perl -w
+# Rebuild the raw TIC byte stream from a decoded dump (e.g. docs/tic_standard)
+# Only the groups whose checksum is OK are kept; a trame starts on each ADSC group
+# The stream is written on stdout, and may be played at 9600 bauds 7E1 to the node,
+# either with a USB-serial adapter on D4 or through the UART input of a simulator:
+#   ticstream.pl docs/tic_standard > tic.raw
+#   stty -F /dev/ttyUSB0 9600 cs7 parenb -parodd -cstopb raw && cat tic.raw > /dev/ttyUSB0
+#
+use strict;
+use warnings;
+
+if( scalar @ARGV < 1 || scalar @ARGV > 2 ){
+	print STDERR "Usage: ".$0." <dump> [<repeat>]\n";
+	exit 1;
+}
+my $dump = $ARGV[0];
+my $repeat = scalar @ARGV == 2 ? $ARGV[1] : 1;
+
+my @trames = ();
+my $trame = undef;
+open( my $fh, '<', $dump ) or die "$dump: $!\n";
+while( my $line = <$fh> ){
+	chomp $line;
+	next unless $line =~ /^([A-Z0-9+-]+\t.*\t)(.) checksum OK$/;
+	my ( $zone, $cks ) = ( $1, $2 );
+	my $computed = 0;
+	$computed += ord( $_ ) for split( //, $zone );
+	$computed = ( $computed & 0x3f ) + 0x20;
+	if( $computed != ord( $cks )){
+		print STDERR "$dump:$.: bad checksum, skipped\n";
+		next;
+	}
+	if( $zone =~ /^ADSC\t/ ){
+		push( @trames, $trame ) if defined $trame;
+		$trame = "";
+	}
+	$trame .= "\n".$zone.$cks."\r" if defined $trame;
+}
+close( $fh );
+push( @trames, $trame ) if defined $trame;
+
+# note that the indexes go backward at each repetition of the dump
+binmode( STDOUT );
+for( my $i=0 ; $i<$repeat ; ++$i ){
+	print "\x02".$_."\x03" for @trames;
+}
+print STDERR scalar( @trames )." trame(s) x".$repeat."\n";
@@ -0,0 +1,133 @@
+/* **********************************************************************************************************
+ * Host test of the wheelTimer class, with a simulated millis():
+ *   g++ -I build/host -I . -o wheeltest build/wheeltest.cpp wheelTimer.cpp && ./wheeltest
+ *
+ * - periodic timers from 150 ms to one day, i.e. across the cascades of the three levels and beyond the
+ *   8192 ms span of the wheel, under a loaded loop (1 to 40 ms between two calls, with 2 s stalls):
+ *   no callback may run early, each one must run at most one loop gap (plus one tick) late, and the
+ *   count of callbacks must follow the elapsed time, i.e. the timers must not drift
+ * - the same timers with an idle loop which sleeps for NextDeadline(): no callback may be more than one
+ *   tick late
+ * - one-shot timers beyond the span, and restarted before their expiration.
+ * The simulated millis() is 32 bits and starts one minute before its wrap, so that all the timers are
+ * armed before it and expire after it.
+ *
+ * Exits with 1 if any check fails.
+ *
+ * pwi 2026-10-18 v1 creation
+ */
+#include <stdlib.h>
+#include "wheelTimer.h"
+
+uint32_t host_ms = 0;
+
+typedef struct {
+    uint32_t period;
+    uint32_t next;                      /* theorical next expiration */
+    uint32_t count;
+    uint32_t late_max;
+    uint32_t early;
+}
+  check_t;
+
+static void check_cb( void *user_data )
+{
+    check_t *c = ( check_t * ) user_data;
+    if(( int32_t )( host_ms-c->next ) < 0 ){
+        c->early += 1;
+    } else if( host_ms-c->next > c->late_max ){
+        c->late_max = host_ms-c->next;
+    }
+    c->count += 1;
+    c->next += c->period;
+}
+
+static const uint32_t st_periods[] = { 150, 1000, 3000, 8192, 10000, 60000, 900000, 86400000 };
+#define PERIODS_COUNT ( sizeof( st_periods ) / sizeof( uint32_t ))
+
+static int run( const char *name, bool idle, uint32_t duration, uint32_t late_allowed )
+{
+    wheelTimer timers[PERIODS_COUNT];
+    check_t checks[PERIODS_COUNT];
+    uint32_t start = host_ms;
+    int failed = 0;
+
+    for( unsigned i=0 ; i<PERIODS_COUNT ; ++i ){
+        checks[i].period = st_periods[i];
+        checks[i].next = start+st_periods[i];
+        checks[i].count = 0;
+        checks[i].late_max = 0;
+        checks[i].early = 0;
+        timers[i].setup( "check", st_periods[i], false, check_cb, &checks[i] );
+        timers[i].start();
+    }
+    while( host_ms-start < duration ){
+        if( idle ){
+            uint32_t next = wheelTimer::NextDeadline();
+            host_ms += next ? next : 1;
+        } else {
+            host_ms += 1+rand()%40;
+            if( rand()%5000 == 0 ){
+                host_ms += 2000;
+            }
+        }
+        wheelTimer::Loop();
+    }
+    for( unsigned i=0 ; i<PERIODS_COUNT ; ++i ){
+        timers[i].stop();
+        uint32_t expected = ( host_ms-start )/checks[i].period;
+        bool ok = !checks[i].early && checks[i].late_max <= late_allowed
+                && checks[i].count+1 >= expected && checks[i].count <= expected;
+        printf( "%s %-6s period=%-9u count=%-7u expected=%-7u early=%u late_max=%u\n",
+                ok ? "ok  " : "FAIL", name, checks[i].period, checks[i].count, expected, checks[i].early, checks[i].late_max );
+        failed |= !ok;
+    }
+    return( failed );
+}
+
+static int run_once( void )
+{
+    check_t beyond = { 20000, host_ms+20000, 0, 0, 0 };
+    check_t restarted = { 5000, 0, 0, 0, 0 };
+    wheelTimer t1, t2;
+    int failed = 0;
+
+    t1.setup( "beyond", 20000, true, check_cb, &beyond );
+    t1.start();
+    t2.setup( "restarted", 5000, true, check_cb, &restarted );
+    t2.start();
+    uint32_t start = host_ms;
+    uint32_t slot = 0;
+    restarted.next = start+5000;
+    while( host_ms-start < 60000 ){
+        host_ms += 1+rand()%40;
+        // restart every 3 s up to 30 s: the timer must only expire 5 s after the last restart
+        if( host_ms-start < 30000 && ( host_ms-start )/3000 != slot ){
+            slot = ( host_ms-start )/3000;
+            t2.restart();
+            restarted.next = host_ms+5000;
+        }
+        wheelTimer::Loop();
+    }
+    bool ok = beyond.count == 1 && !beyond.early && beyond.late_max <= 40+WHEEL_TICK_MS;
+    printf( "%s once   beyond the span: count=%u early=%u late=%u\n", ok ? "ok  " : "FAIL", beyond.count, beyond.early, beyond.late_max );
+    failed |= !ok;
+    ok = restarted.count == 1 && !restarted.early && restarted.late_max <= 40+WHEEL_TICK_MS;
+    printf( "%s once   restarted: count=%u early=%u late=%u\n", ok ? "ok  " : "FAIL", restarted.count, restarted.early, restarted.late_max );
+    failed |= !ok;
+    return( failed );
+}
+
+int main( void )
+{
+    int failed = 0;
+    srand( 1 );
+    // catch up the wheel with the start time, which is a multiple of the tick
+    host_ms = 0xffffffffUL-60000UL+1;
+    wheelTimer::Loop();
+    failed |= run( "loaded", false, 3*86400000UL, 2040+WHEEL_TICK_MS );
+    failed |= run( "idle", true, 2*86400000UL, WHEEL_TICK_MS );
+    failed |= run_once();
+    printf( "%s\n", failed ? "FAILED" : "all checks passed" );
+    return( failed );
+}
@@ -11,10 +11,16 @@ enum {
     CHILD_MAIN_ACTION_RESET       = CHILD_MAIN+1,
     CHILD_MAIN_ACTION_DUMP        = CHILD_MAIN+2,
     CHILD_MAIN_ACTION_LOG_IGNORED = CHILD_MAIN+3,
-    //
+    CHILD_MAIN_ACTION_LOW_POWER   = CHILD_MAIN+4,
+    CHILD_MAIN_DUTY_CYCLE         = CHILD_MAIN+5,
     CHILD_MAIN_PARM_DUMP_PERIOD   = CHILD_MAIN+6,
     CHILD_MAIN_PARM_MIN_PERIOD    = CHILD_MAIN+7,
     CHILD_MAIN_PARM_MAX_PERIOD    = CHILD_MAIN+8,
+    CHILD_MAIN_PARM_RULE1         = CHILD_MAIN+9,
+    CHILD_MAIN_PARM_RULE2         = CHILD_MAIN+10,
+    CHILD_MAIN_LOAD               = CHILD_MAIN+11,
+    CHILD_MAIN_ACTION_HISTOGRAM   = CHILD_MAIN+12,
+    CHILD_MAIN_ACTION_RESYNC      = CHILD_MAIN+13,
     //
     CHILD_TI                      = 100,
     CHILD_ID_ADSC                 = CHILD_TI+0,
@@ -25,7 +31,23 @@ enum {
     CHILD_ID_EAST                 = CHILD_TI+5,
     CHILD_ID_EASF01               = CHILD_TI+6,
     CHILD_ID_EASF02               = CHILD_TI+7,
-    //
+    CHILD_ID_EASF03               = CHILD_TI+8,
+    CHILD_ID_EASF04               = CHILD_TI+9,
+    CHILD_ID_EASF05               = CHILD_TI+10,
+    CHILD_ID_EASF06               = CHILD_TI+11,
+    CHILD_ID_EASF07               = CHILD_TI+12,
+    CHILD_ID_EASF08               = CHILD_TI+13,
+    CHILD_ID_EASF09               = CHILD_TI+14,
+    CHILD_ID_EASF10               = CHILD_TI+15,
+    CHILD_ID_EASD01               = CHILD_TI+16,
+    CHILD_ID_EASD02               = CHILD_TI+17,
+    CHILD_ID_EASD03               = CHILD_TI+18,
+    CHILD_ID_EASD04               = CHILD_TI+19,
+    CHILD_ID_EAIT                 = CHILD_TI+20,
+    CHILD_ID_ERQ1                 = CHILD_TI+21,
+    CHILD_ID_ERQ2                 = CHILD_TI+22,
+    CHILD_ID_ERQ3                 = CHILD_TI+23,
+    CHILD_ID_ERQ4                 = CHILD_TI+24,
     CHILD_ID_IRMS1                = CHILD_TI+25,
     //
     CHILD_ID_URMS1                = CHILD_TI+28,
@@ -38,18 +60,57 @@ enum {
     //
     CHILD_ID_SMAXSN_1             = CHILD_TI+41,
     //
+    CHILD_ID_SINSTI               = CHILD_TI+45,
+    CHILD_ID_SMAXIN               = CHILD_TI+46,
+    CHILD_ID_SMAXIN_1             = CHILD_TI+47,
     CHILD_ID_CCASN                = CHILD_TI+48,
     CHILD_ID_CCASN_1              = CHILD_TI+49,
-    //
+    CHILD_ID_CCAIN                = CHILD_TI+50,
+    CHILD_ID_CCAIN_1              = CHILD_TI+51,
     CHILD_ID_UMOY1                = CHILD_TI+52,
     //
     CHILD_ID_STGE                 = CHILD_TI+55,
     //
+    CHILD_ID_MSG1                 = CHILD_TI+62,
+    CHILD_ID_MSG2                 = CHILD_TI+63,
     CHILD_ID_PRM                  = CHILD_TI+64,
-    //
+    CHILD_ID_RELAIS               = CHILD_TI+65,
     CHILD_ID_NTARF                = CHILD_TI+66,
+    CHILD_ID_NJOURF               = CHILD_TI+67,
+    CHILD_ID_NJOURF_1             = CHILD_TI+68,
     //
     CHILD_ID_HCHP                 = CHILD_TI-1,
+    CHILD_ID_NEXT_SWITCH          = CHILD_TI-2,
+    CHILD_ID_POWER                = CHILD_TI-3,
+    CHILD_ID_ERRORS               = CHILD_TI-4,
+    CHILD_ID_TIMING               = CHILD_TI-5,
+    CHILD_ID_HALFHOUR             = CHILD_TI-6,
+    CHILD_ID_NET_POWER            = CHILD_TI-7,
+    CHILD_ID_ENERGY_TODAY         = CHILD_TI-8,
+    CHILD_ID_ENERGY_MONTH         = CHILD_TI-9,
+    CHILD_ID_ENERGY_DAY_CLOSED    = CHILD_TI-10,
+    CHILD_ID_ENERGY_MONTH_CLOSED  = CHILD_TI-11,
+    CHILD_ID_QUEUES               = CHILD_TI-12,
+    //
+    CHILD_STGE                    = 200,
+    CHILD_ID_STGE_DRY_CONTACT     = CHILD_STGE+0,
+    CHILD_ID_STGE_CUTOFF          = CHILD_STGE+1,
+    CHILD_ID_STGE_COVER           = CHILD_STGE+2,
+    CHILD_ID_STGE_OVERVOLTAGE     = CHILD_STGE+3,
+    CHILD_ID_STGE_OVERLOAD        = CHILD_STGE+4,
+    CHILD_ID_STGE_PRODUCER        = CHILD_STGE+5,
+    CHILD_ID_STGE_NEGATIVE        = CHILD_STGE+6,
+    CHILD_ID_STGE_SUPPLIER        = CHILD_STGE+7,
+    CHILD_ID_STGE_DISTRIBUTOR     = CHILD_STGE+8,
+    CHILD_ID_STGE_CLOCK           = CHILD_STGE+9,
+    CHILD_ID_STGE_TIC_MODE        = CHILD_STGE+10,
+    CHILD_ID_STGE_EURIDIS         = CHILD_STGE+11,
+    CHILD_ID_STGE_CPL_STATUS      = CHILD_STGE+12,
+    CHILD_ID_STGE_CPL_SYNC        = CHILD_STGE+13,
+    CHILD_ID_STGE_TEMPO_TODAY     = CHILD_STGE+14,
+    CHILD_ID_STGE_TEMPO_TOMORROW  = CHILD_STGE+15,
+    CHILD_ID_STGE_PEAK_NOTICE     = CHILD_STGE+16,
+    CHILD_ID_STGE_PEAK            = CHILD_STGE+17,
 };
 
 #endif // __CHILDIDS_H__
@@ -2,9 +2,14 @@
 
 /* **********************************************************************************************************
  *  EEPROM management
- *  
+ *
  * pwi 2019- 6- 1 v1 creation
  * pwi 2025-10- 1 v3 remove dup_thread
+ * pwi 2026-10-18 v4 log-structured store with wear levelling and lazy writes
+ * pwi 2026-10-18 v5 add low_power
+ * pwi 2026-10-18 v6 add load shedding rules
+ * pwi 2026-10-18 v7 add layout
+ * pwi 2026-10-18 v8 checkpoint the injection indexes, add the histogram ring
  */
 
 // uncomment for debugging eeprom functions
@@ -12,6 +17,89 @@
 
 static const char pwiLabel[] PROGMEM = "PWI";
 
+/* the v3 layout was a flat sEeprom written at address 0
+ */
+#define EEPROM_V3_SIZE        17
+
+/* a ring of slots, each slot being able to hold one record
+ */
+typedef struct {
+    uint8_t       base;
+    uint8_t       slot_size;
+    uint8_t       slots;
+    uint8_t       seq;                  /* sequence number of the last written record */
+    uint8_t       slot;                 /* slot of the last written record */
+}
+  sRing;
+
+static sRing    st_config     = { EEPROM_CONFIG_BASE, EEPROM_CONFIG_SLOT, EEPROM_CONFIG_SLOTS, 0, EEPROM_CONFIG_SLOTS-1 };
+static sRing    st_histogram  = { EEPROM_HISTOGRAM_BASE, EEPROM_HISTOGRAM_SLOT, EEPROM_HISTOGRAM_SLOTS, 0, EEPROM_HISTOGRAM_SLOTS-1 };
+static sRing    st_checkpoint = { EEPROM_CHECKPOINT_BASE, EEPROM_CHECKPOINT_SLOT, EEPROM_CHECKPOINT_SLOTS, 0, EEPROM_CHECKPOINT_SLOTS-1 };
+static bool     st_dirty = false;
+static uint32_t st_dirty_ms = 0;
+
+static void eepromDefaults( sEeprom &data );
+static void ringClear( sRing &ring, pEepromWrite pfnWrite );
+static bool ringRead( sRing &ring, void *data, uint8_t size, pEepromRead pfnRead );
+static void ringWrite( sRing &ring, const void *data, uint8_t size, pEepromWrite pfnWrite );
+
+/**
+ * eepromCheckpointRead:
+ *
+ * Returns: %TRUE if a valid checkpoint has been found and loaded in @data.
+ */
+bool eepromCheckpointRead( sCheckpoint &data, pEepromRead pfnRead )
+{
+    memset( &data, '\0', sizeof( sCheckpoint ));
+    return( ringRead( st_checkpoint, &data, sizeof( sCheckpoint ), pfnRead ));
+}
+
+/**
+ * eepromCheckpointWrite:
+ *
+ * Append a new checkpoint in the next slot of the checkpoint ring.
+ */
+void eepromCheckpointWrite( sCheckpoint &data, pEepromWrite pfnWrite )
+{
+#ifdef EEPROM_DEBUG
+    Serial.println( F( "[eepromCheckpointWrite]" ));
+#endif
+    ringWrite( st_checkpoint, &data, sizeof( sCheckpoint ), pfnWrite );
+}
+
+/**
+ * eepromCrc8:
+ * @crc: the current crc.
+ * @byte: the byte to be added.
+ *
+ * Returns: the updated Dallas/Maxim crc8.
+ */
+uint8_t eepromCrc8( uint8_t crc, uint8_t byte )
+{
+    crc ^= byte;
+    for( uint8_t i=0 ; i<8 ; ++i ){
+        crc = ( crc & 0x01 ) ? ( crc >> 1 ) ^ 0x8c : ( crc >> 1 );
+    }
+    return( crc );
+}
+
+/**
+ * eepromDefaults:
+ */
+static void eepromDefaults( sEeprom &data )
+{
+    memset( &data, '\0', sizeof( sEeprom ));
+    strcpy_P( data.mark, pwiLabel );
+    data.version = EEPROM_VERSION;
+
+    data.min_period_ms = 10000;     // 10s
+    data.max_period_ms = 3600000;   // 1h
+    data.auto_dump_ms = 86400000;   // 24h
+    data.low_power = 0;
+    // rules are disabled (zeroed)
+    // layout is unknown (zeroed)
+}
+
 /**
  * eepromDump:
  */
@@ -20,23 +108,103 @@ void eepromDump( sEeprom &data )
 #ifdef EEPROM_DEBUG
     Serial.print( F( "[eepromDump] mark='" ));         Serial.print( data.mark ); Serial.println( F( "'" ));
     Serial.print( F( "[eepromDump] version=" ));       Serial.println( data.version );
+    Serial.print( F( "[eepromDump] seq=" ));           Serial.print( st_config.seq );
+    Serial.print( F( ", slot=" ));                     Serial.println( st_config.slot );
     Serial.print( F( "[eepromDump] min_period_ms=" )); Serial.println( data.min_period_ms );
     Serial.print( F( "[eepromDump] max_period_ms=" )); Serial.println( data.max_period_ms );
     Serial.print( F( "[eepromDump] auto_dump_ms=" ));  Serial.println( data.auto_dump_ms );
+    Serial.print( F( "[eepromDump] low_power=" ));     Serial.println( data.low_power );
+    for( uint8_t i=0 ; i<EEPROM_RULES ; ++i ){
+        Serial.print( F( "[eepromDump] rule" ));       Serial.print( i+1 );
+        Serial.print( F( " type=" ));                  Serial.print( data.rules[i].type );
+        Serial.print( F( ", arg=" ));                  Serial.print( data.rules[i].arg );
+        Serial.print( F( ", frames=" ));               Serial.print( data.rules[i].frames );
+        Serial.print( F( ", pin=" ));                  Serial.println( data.rules[i].pin );
+    }
+    Serial.print( F( "[eepromDump] layout=" ));        Serial.println( data.layout );
+#endif
+}
+
+/**
+ * eepromHistogramRead:
+ *
+ * Returns: %TRUE if a valid histogram has been found and loaded in @data.
+ */
+bool eepromHistogramRead( sHistogram &data, pEepromRead pfnRead )
+{
+    memset( &data, '\0', sizeof( sHistogram ));
+    return( ringRead( st_histogram, &data, sizeof( sHistogram ), pfnRead ));
+}
+
+/**
+ * eepromHistogramWrite:
+ *
+ * Append a new histogram in the next slot of the histogram ring.
+ */
+void eepromHistogramWrite( sHistogram &data, pEepromWrite pfnWrite )
+{
+#ifdef EEPROM_DEBUG
+    Serial.println( F( "[eepromHistogramWrite]" ));
 #endif
+    ringWrite( st_histogram, &data, sizeof( sHistogram ), pfnWrite );
+}
+
+/**
+ * eepromLoop:
+ *
+ * To be called from the main loop().
+ * Actually writes the data if they have been modified, and are stable since EEPROM_LAZY_MS.
+ *
+ * Returns: %TRUE if the data has been written.
+ */
+bool eepromLoop( sEeprom &data, pEepromWrite pfnWrite )
+{
+    if( st_dirty && millis() - st_dirty_ms >= EEPROM_LAZY_MS ){
+        eepromWrite( data, pfnWrite );
+        return( true );
+    }
+    return( false );
 }
 
 /**
  * eepromRead:
+ *
+ * Load the most recent valid record of the configuration ring.
+ * Records written by a previous version are migrated to the current one.
  */
 void eepromRead( sEeprom &data, pEepromRead pfnRead, pEepromWrite pfnWrite )
 {
-    for( uint8_t i=0 ; i<sizeof( sEeprom ); ++i ){
-        (( uint8_t * ) &data )[i] = pfnRead( i );
+    eepromDefaults( data );
+    bool found = ringRead( st_config, &data, sizeof( sEeprom ), pfnRead );
+
+    // not found: try the v3 flat layout
+    if( !found ){
+        if( pfnRead( 0 ) == 'P' && pfnRead( 1 ) == 'W' && pfnRead( 2 ) == 'I' && pfnRead( 3 ) == 0 && pfnRead( 4 ) == 3 ){
+            for( uint8_t i=5 ; i<EEPROM_V3_SIZE; ++i ){
+                (( uint8_t * ) &data )[i] = pfnRead( i );
+            }
+            data.version = 3;
+            found = true;
+        }
     }
-    // initialize with default values if mark not found or incorrect version
-    if( data.mark[0] != 'P' || data.mark[1] != 'W' || data.mark[2] != 'I' || data.mark[3] != 0 || data.version != EEPROM_VERSION ){
+
+    // initialize with default values if nothing can be recovered
+    if( !found ){
         eepromReset( data, pfnWrite );
+        ringClear( st_histogram, pfnWrite );
+
+    } else if( data.version != EEPROM_VERSION ){
+#ifdef EEPROM_DEBUG
+        Serial.print( F( "[eepromRead] migrating from v" ));
+        Serial.println( data.version );
+#endif
+        uint8_t from = data.version;
+        data.version = EEPROM_VERSION;
+        eepromWrite( data, pfnWrite );
+        // the histogram slot still holds a checkpoint record
+        if( from < 8 ){
+            ringClear( st_histogram, pfnWrite );
+        }
     }
 }
 
@@ -48,27 +216,122 @@ void eepromReset( sEeprom &data, pEepromWrite pfnWrite )
 #ifdef EEPROM_DEBUG
     Serial.println( F( "[eepromReset]" ));
 #endif
-    memset( &data, '\0', sizeof( sEeprom ));
-    strcpy_P( data.mark, pwiLabel );
-    data.version = EEPROM_VERSION;
-  
-    data.min_period_ms = 10000;     // 10s
-    data.max_period_ms = 3600000;   // 1h
-    data.auto_dump_ms = 86400000;   // 24h
-  
+    eepromDefaults( data );
     eepromWrite( data, pfnWrite );
 }
 
+/**
+ * eepromSchedule:
+ *
+ * Mark the data as modified: they will be written by eepromLoop()
+ * after EEPROM_LAZY_MS without any other change.
+ */
+void eepromSchedule( void )
+{
+    st_dirty = true;
+    st_dirty_ms = millis();
+}
+
 /**
  * eepromWrite:
+ *
+ * Immediately append a new record in the next slot of the configuration ring.
  */
 void eepromWrite( sEeprom &data, pEepromWrite pfnWrite )
 {
 #ifdef EEPROM_DEBUG
     Serial.println( F( "[eepromWrite]" ));
 #endif
-    for( uint8_t i=0 ; i<sizeof( sEeprom ); ++i ){
-        pfnWrite( i, (( uint8_t * ) &data )[i] );
+    st_dirty = false;
+    ringWrite( st_config, &data, sizeof( sEeprom ), pfnWrite );
+}
+
+/**
+ * ringClear:
+ * @ring: the ring to be invalidated.
+ *
+ * Zero the length of each slot, so that no record is found there.
+ */
+static void ringClear( sRing &ring, pEepromWrite pfnWrite )
+{
+    for( uint8_t slot=0 ; slot<ring.slots ; ++slot ){
+        pfnWrite( ring.base + slot * ring.slot_size + 1, 0 );
+    }
+}
+
+/**
+ * ringRead:
+ * @ring: the ring to be scanned.
+ * @data: the destination buffer, which must have been initialized with default values.
+ * @size: the size of @data.
+ *
+ * Scan the ring, and load the most recent valid record into @data.
+ * A record shorter than @size (written by a previous version) only overrides the head of @data.
+ *
+ * Returns: %TRUE if a valid record has been found.
+ */
+static bool ringRead( sRing &ring, void *data, uint8_t size, pEepromRead pfnRead )
+{
+    bool found = false;
+
+    for( uint8_t slot=0 ; slot<ring.slots ; ++slot ){
+        uint8_t addr = ring.base + slot * ring.slot_size;
+        uint8_t seq = pfnRead( addr );
+        uint8_t len = pfnRead( addr+1 );
+        if( len == 0 || len > ring.slot_size-3 ){
+            continue;
+        }
+        uint8_t crc = eepromCrc8( eepromCrc8( 0, seq ), len );
+        for( uint8_t i=0 ; i<len ; ++i ){
+            crc = eepromCrc8( crc, pfnRead( addr+2+i ));
+        }
+        if( crc == pfnRead( addr+2+len ) && ( !found || ( int8_t )( seq - ring.seq ) > 0 )){
+            ring.seq = seq;
+            ring.slot = slot;
+            found = true;
+        }
     }
+
+    if( found ){
+        uint8_t addr = ring.base + ring.slot * ring.slot_size;
+        uint8_t len = pfnRead( addr+1 );
+        for( uint8_t i=0 ; i<len && i<size ; ++i ){
+            (( uint8_t * ) data )[i] = pfnRead( addr+2+i );
+        }
+    }
+
+    return( found );
 }
 
+/**
+ * ringWrite:
+ * @ring: the target ring.
+ * @data: the record to be written.
+ * @size: the size of @data.
+ *
+ * Append a new record in the next slot of the ring.
+ * A record which would not fit in a slot is not written, rather than overwriting the next one.
+ */
+static void ringWrite( sRing &ring, const void *data, uint8_t size, pEepromWrite pfnWrite )
+{
+    if( size > ring.slot_size-3 ){
+#ifdef EEPROM_DEBUG
+        Serial.print( F( "[ringWrite] record too large: size=" ));
+        Serial.println( size );
+#endif
+        return;
+    }
+    ring.seq += 1;
+    ring.slot = ( ring.slot+1 ) % ring.slots;
+
+    uint8_t addr = ring.base + ring.slot * ring.slot_size;
+    uint8_t crc = eepromCrc8( eepromCrc8( 0, ring.seq ), size );
+    pfnWrite( addr, ring.seq );
+    pfnWrite( addr+1, size );
+    for( uint8_t i=0 ; i<size ; ++i ){
+        uint8_t byte = (( const uint8_t * ) data )[i];
+        crc = eepromCrc8( crc, byte );
+        pfnWrite( addr+2+i, byte );
+    }
+    pfnWrite( addr+2+size, crc );
+}
@@ -6,17 +6,85 @@
 /* **********************************************************************************************************
  *  EEPROM description
  *  This is the data structure saved in the EEPROM.
- * 
+ *
  *  MySensors leave us with 256 bytes to save configuration data in the EEPROM.
- * 
+ *
+ *  Since v4, the structure is no more written in place at address 0, but appended as a record in a ring
+ *  of EEPROM_CONFIG_SLOTS slots (the log), each record being:
+ *
+ *    | seq | len | sEeprom data (len bytes) | crc8 |
+ *
+ *  - seq is incremented modulo 256 on each write, the most recent valid record wins at read time
+ *  - each write goes to the next slot, so that the EEPROM wear is spread over the whole ring
+ *  - new fields must only be appended at the end of the structure: an older record is so a prefix of the
+ *    current structure, and the forward migration just consists in completing it with default values.
+ *
+ *  Writes are lazy: the setters just mark the data as dirty, and the record is actually written by
+ *  eepromLoop() when no other change has been received since EEPROM_LAZY_MS.
+ *
+ *  The end of the EEPROM is another ring, used to periodically checkpoint the energy indexes, so that
+ *  their validation survives to a reboot.
+ *
+ *  Since v8, the checkpoint also holds the injection indexes of the producer meters, in a single slot,
+ *  and the freed space holds a third ring, of a single slot too, which checkpoints the SINSTS sizing
+ *  histogram:
+ *
+ *    |   0 - 191 | configuration, 6 x 32 |
+ *    | 192 - 226 | checkpoint, 1 x 35    |
+ *    | 227 - 229 | unused                |
+ *    | 230 - 255 | histogram, 1 x 26     |
+ *
+ *  The configuration ring and the first checkpoint slot are unchanged since v4, an older checkpoint
+ *  being a prefix of the current one, so that only the histogram slot is invalidated when migrating
+ *  from an older version. As the single slots are rewritten in place, a write interrupted by a reset
+ *  loses the checkpoint or the histogram, which are then restarted.
+ *
  * pwi 2019- 6- 1 v1 creation
  * pwi 2025-10- 1 v3 remove dup_thread
+ * pwi 2026-10-18 v4 log-structured store with wear levelling and lazy writes
+ * pwi 2026-10-18 v5 add low_power
+ * pwi 2026-10-18 v6 add load shedding rules
+ * pwi 2026-10-18 v7 add layout
+ * pwi 2026-10-18 v8 checkpoint the injection indexes, add the histogram ring
  */
-#define EEPROM_VERSION    3
+#define EEPROM_VERSION        8
+
+#define EEPROM_CONFIG_BASE    0
+#define EEPROM_CONFIG_SLOT    32        /* size of a slot, must be greater than sizeof( sEeprom )+3 */
+#define EEPROM_CONFIG_SLOTS   6
+#define EEPROM_LAZY_MS        5000      /* coalesce the changes received during this delay */
+
+#define EEPROM_CHECKPOINT_BASE  ( EEPROM_CONFIG_BASE+EEPROM_CONFIG_SLOT*EEPROM_CONFIG_SLOTS )
+#define EEPROM_CHECKPOINT_SLOT  35      /* must be at least sizeof( sCheckpoint )+3 */
+#define EEPROM_CHECKPOINT_SLOTS 1
+
+#define EEPROM_HISTOGRAM_SLOT   26      /* must be at least sizeof( sHistogram )+3 */
+#define EEPROM_HISTOGRAM_SLOTS  1
+#define EEPROM_HISTOGRAM_BASE   ( 256-EEPROM_HISTOGRAM_SLOT*EEPROM_HISTOGRAM_SLOTS )
+#define EEPROM_HISTOGRAM_SIZE   11      /* count of buckets */
+
+#define EEPROM_RULES          2         /* count of load shedding rules */
 
 typedef uint8_t pEepromRead( uint8_t );
 typedef void    pEepromWrite( uint8_t, uint8_t );
 
+/* a load shedding rule, evaluated on each committed trame (see Linky::rulesApply())
+ */
+enum {
+    RULE_NONE = 0,
+    RULE_OVERLOAD,                      /* drive the pin while SINSTS > arg % of PREF */
+    RULE_RELAIS,                        /* follow the bit arg (0-7) of RELAIS */
+    RULE_SURPLUS                        /* drive the pin while SINSTI-SINSTS > arg*100 VA */
+};
+
+typedef struct {
+    uint8_t       type;
+    uint8_t       arg;
+    uint8_t       frames;               /* count of consecutive trames before the pin is switched */
+    uint8_t       pin;                  /* the output pin, 0 if unused */
+}
+  sRule;
+
 typedef struct {
     /* a 'PWI' null-terminated string which marks the structure as initialized */
     char          mark[4];
@@ -25,13 +93,43 @@ typedef struct {
     unsigned long min_period_ms;
     unsigned long max_period_ms;
     unsigned long auto_dump_ms;
+    /* power management */
+    uint8_t       low_power;
+    /* load shedding */
+    sRule         rules[EEPROM_RULES];
+    /* identifier of the build whose presentation has been fully sent, 0 if none */
+    uint16_t      layout;
 }
   sEeprom;
 
-void eepromDump( sEeprom &data );
-void eepromRead( sEeprom &data, pEepromRead pfnRead, pEepromWrite pfnWrite );
-void eepromReset( sEeprom &data, pEepromWrite pfn );
-void eepromWrite( sEeprom &data, pEepromWrite pfn );
+typedef struct {
+    uint32_t      east;
+    uint32_t      easf01;
+    uint32_t      easf02;
+    /* producer meters, since v8 */
+    uint32_t      eait;
+    uint32_t      erq[4];               /* ERQ1..ERQ4 */
+}
+  sCheckpoint;
 
-#endif // __EEPROM_H__
+/* the SINSTS sizing histogram, relative to PREF (see Linky.h)
+ */
+typedef struct {
+    uint8_t       pref;                 /* the PREF the counts are relative to */
+    uint16_t      count[EEPROM_HISTOGRAM_SIZE];     /* all halved when one would overflow */
+}
+  sHistogram;
 
+bool    eepromCheckpointRead( sCheckpoint &data, pEepromRead pfnRead );
+void    eepromCheckpointWrite( sCheckpoint &data, pEepromWrite pfnWrite );
+uint8_t eepromCrc8( uint8_t crc, uint8_t byte );
+void    eepromDump( sEeprom &data );
+bool    eepromHistogramRead( sHistogram &data, pEepromRead pfnRead );
+void    eepromHistogramWrite( sHistogram &data, pEepromWrite pfnWrite );
+bool    eepromLoop( sEeprom &data, pEepromWrite pfnWrite );
+void    eepromRead( sEeprom &data, pEepromRead pfnRead, pEepromWrite pfnWrite );
+void    eepromReset( sEeprom &data, pEepromWrite pfn );
+void    eepromSchedule( void );
+void    eepromWrite( sEeprom &data, pEepromWrite pfn );
+
+#endif // __EEPROM_H__
@@ -0,0 +1,272 @@
+#include "icpSerial.h"
+
+/* **********************************************************************************************************
+ * A receive-only 7E1 serial port based on the Timer1 input capture.
+ *
+ * pwi 2026-10-18 v1 creation
+ */
+
+#ifdef ICPSERIAL
+
+volatile uint8_t  icpSerial::st_buffer[ICPSERIAL_BUFSIZE];
+volatile uint8_t  icpSerial::st_head = 0;
+volatile uint8_t  icpSerial::st_tail = 0;
+volatile uint16_t icpSerial::st_errors = 0;
+volatile uint16_t icpSerial::st_cycles = 0;
+volatile uint16_t icpSerial::st_cycles_max = 0;
+uint16_t          icpSerial::st_bit = 0;
+uint16_t          icpSerial::st_inv = 0;
+uint16_t          icpSerial::st_start = 0;
+uint16_t          icpSerial::st_last = 0;
+uint16_t          icpSerial::st_frame = 0;
+uint16_t          icpSerial::st_acc = 0;
+uint8_t           icpSerial::st_pos = 0;
+uint8_t           icpSerial::st_level = 1;
+bool              icpSerial::st_in_char = false;
+
+ISR( TIMER1_CAPT_vect )
+{
+    icpSerial::CaptureIsr();
+}
+
+ISR( TIMER1_COMPA_vect )
+{
+    icpSerial::CompareIsr();
+}
+
+/**
+ * icpSerial::icpSerial:
+ * @rxPin: the reception pin, which must be ICPSERIAL_RX_PIN.
+ * @txPin: unused.
+ *
+ * Constructor.
+ *
+ * Public.
+ */
+icpSerial::icpSerial( uint8_t /* rxPin */, uint8_t /* txPin */ )
+{
+}
+
+/**
+ * icpSerial::available:
+ *
+ * Returns: the count of received characters.
+ *
+ * Public.
+ */
+int icpSerial::available( void )
+{
+    return(( uint8_t )( icpSerial::st_head+ICPSERIAL_BUFSIZE-icpSerial::st_tail ) % ICPSERIAL_BUFSIZE );
+}
+
+/**
+ * icpSerial::begin:
+ * @speed: the speed in bauds.
+ *
+ * Take the control of Timer1, and start the reception.
+ *
+ * Public.
+ */
+void icpSerial::begin( long speed )
+{
+    icpSerial::st_bit = F_CPU / speed;
+    icpSerial::st_inv = (( 1UL << ICPSERIAL_INV_SHIFT )+icpSerial::st_bit/2 ) / icpSerial::st_bit;
+    pinMode( ICPSERIAL_RX_PIN, INPUT );
+
+    noInterrupts();
+    TCCR1A = 0;
+    TCCR1B = _BV( ICNC1 ) | _BV( CS10 );        // normal mode, no prescaler, falling edge
+    TCCR1C = 0;
+    TIFR1 = _BV( ICF1 ) | _BV( OCF1A );
+    TIMSK1 = _BV( ICIE1 );
+    interrupts();
+}
+
+/**
+ * icpSerial::getCycles:
+ *
+ * Returns: the count of CPU cycles spent in the interrupts for the last character.
+ *
+ * Public.
+ */
+uint16_t icpSerial::getCycles( void )
+{
+    noInterrupts();
+    uint16_t cycles = icpSerial::st_cycles;
+    interrupts();
+    return( cycles );
+}
+
+/**
+ * icpSerial::getCyclesMax:
+ *
+ * Returns: the max count of CPU cycles spent in the interrupts for a character.
+ *
+ * Public.
+ */
+uint16_t icpSerial::getCyclesMax( void )
+{
+    noInterrupts();
+    uint16_t cycles = icpSerial::st_cycles_max;
+    interrupts();
+    return( cycles );
+}
+
+/**
+ * icpSerial::getErrors:
+ *
+ * Returns: the count of dropped characters (framing, parity, or buffer full).
+ *
+ * Public.
+ */
+uint16_t icpSerial::getErrors( void )
+{
+    noInterrupts();
+    uint16_t errors = icpSerial::st_errors;
+    interrupts();
+    return( errors );
+}
+
+/**
+ * icpSerial::read:
+ *
+ * Returns: the next received character, or -1.
+ *
+ * Public.
+ */
+int icpSerial::read( void )
+{
+    if( icpSerial::st_head == icpSerial::st_tail ){
+        return( -1 );
+    }
+    uint8_t c = icpSerial::st_buffer[icpSerial::st_tail];
+    icpSerial::st_tail = ( icpSerial::st_tail+1 ) % ICPSERIAL_BUFSIZE;
+    return( c );
+}
+
+/**
+ * icpSerial::CaptureIsr:
+ *
+ * An edge has been captured.
+ * A falling edge while idle is a start bit, other edges end a run of bits of the previous level.
+ *
+ * Static public.
+ */
+void icpSerial::CaptureIsr( void )
+{
+    uint16_t enter = TCNT1;
+    uint16_t now = ICR1;
+    uint8_t level = ( TCCR1B & _BV( ICES1 )) ? 1 : 0;
+
+    // the compare interrupt may not have run yet when the next start bit immediately follows the stop bit
+    if( icpSerial::st_in_char && ( uint16_t )( now-icpSerial::st_start ) >= ICPSERIAL_BITS*icpSerial::st_bit-icpSerial::st_bit/2 ){
+        icpSerial::Complete( enter );
+        enter = TCNT1;
+    }
+
+    // capture the next (opposite) edge; the flag must be cleared after a change of the edge
+    if( level ){
+        TCCR1B &= ~_BV( ICES1 );
+    } else {
+        TCCR1B |= _BV( ICES1 );
+    }
+    TIFR1 = _BV( ICF1 );
+
+    if( icpSerial::st_in_char ){
+        icpSerial::Fill( now );
+        icpSerial::st_level = level;
+
+    } else if( !level ){
+        icpSerial::st_in_char = true;
+        icpSerial::st_start = now;
+        icpSerial::st_last = now;
+        icpSerial::st_frame = 0;
+        icpSerial::st_pos = 0;
+        icpSerial::st_level = 0;
+        icpSerial::st_acc = 0;
+        // middle of the stop bit
+        OCR1A = now+ICPSERIAL_BITS*icpSerial::st_bit-icpSerial::st_bit/2;
+        TIFR1 = _BV( OCF1A );
+        TIMSK1 |= _BV( OCIE1A );
+    }
+
+    icpSerial::st_acc += TCNT1-enter;
+}
+
+/**
+ * icpSerial::CompareIsr:
+ *
+ * The middle of the stop bit has been reached.
+ *
+ * Static public.
+ */
+void icpSerial::CompareIsr( void )
+{
+    uint16_t enter = TCNT1;
+    if( icpSerial::st_in_char ){
+        icpSerial::Complete( enter );
+    }
+}
+
+/**
+ * icpSerial::Complete:
+ * @enter: the time at which the current interrupt has been entered.
+ *
+ * Fill the trailing bits, check the frame and store the character.
+ *
+ * Static private.
+ */
+void icpSerial::Complete( uint16_t enter )
+{
+    icpSerial::Fill( icpSerial::st_start+ICPSERIAL_BITS*icpSerial::st_bit );
+    icpSerial::st_in_char = false;
+    TIMSK1 &= ~_BV( OCIE1A );
+
+    // start bit at 0, stop bit at 1, even parity on data+parity
+    uint16_t frame = icpSerial::st_frame;
+    uint8_t parity = ( frame >> 1 ) & 0xff;
+    parity ^= parity >> 4;
+    parity ^= parity >> 2;
+    parity ^= parity >> 1;
+    uint8_t next = ( icpSerial::st_head+1 ) % ICPSERIAL_BUFSIZE;
+
+    if(( frame & 0x01 ) || !( frame & ( 1 << ( ICPSERIAL_BITS-1 ))) || ( parity & 0x01 ) || next == icpSerial::st_tail ){
+        icpSerial::st_errors += 1;
+    } else {
+        icpSerial::st_buffer[icpSerial::st_head] = ( frame >> 1 ) & 0x7f;
+        icpSerial::st_head = next;
+    }
+
+    uint16_t cycles = icpSerial::st_acc+( TCNT1-enter );
+    icpSerial::st_cycles = cycles;
+    if( cycles > icpSerial::st_cycles_max ){
+        icpSerial::st_cycles_max = cycles;
+    }
+}
+
+/**
+ * icpSerial::Fill:
+ * @now: the time of the edge which ends the current run of bits.
+ *
+ * Append the bits of the current level since the last edge.
+ * The count of bits is computed with a multiplication by the inverse of the bit time, rather than a
+ * division.
+ *
+ * Static private.
+ */
+void icpSerial::Fill( uint16_t now )
+{
+    uint16_t elapsed = now-icpSerial::st_last;
+    uint8_t n = (( uint32_t ) elapsed*icpSerial::st_inv+( 1UL << ( ICPSERIAL_INV_SHIFT-1 ))) >> ICPSERIAL_INV_SHIFT;
+
+    if( icpSerial::st_pos+n > ICPSERIAL_BITS ){
+        n = ICPSERIAL_BITS-icpSerial::st_pos;
+    }
+    if( icpSerial::st_level ){
+        icpSerial::st_frame |= (( 1 << n )-1 ) << icpSerial::st_pos;
+    }
+    icpSerial::st_pos += n;
+    icpSerial::st_last = now;
+}
+
+#endif // ICPSERIAL
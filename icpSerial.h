@@ -0,0 +1,72 @@
+#ifndef __ICPSERIAL_H__
+#define __ICPSERIAL_H__
+
+#include <Arduino.h>
+
+/* **********************************************************************************************************
+ * A receive-only 7E1 serial port based on the Timer1 input capture.
+ *
+ * SoftwareSerial samples a whole character inside its pin change interrupt, i.e. it masks the interrupts
+ * during about 1 ms at 9600 bauds, which competes with the radio. Here, the Timer1 input capture unit
+ * latches the time of each edge of the ICP1 pin (D8), so that the interrupt only has to convert the
+ * elapsed time since the previous edge into a count of bits, whatever its latency:
+ *
+ *   - the capture interrupt runs on each edge, and fills the bits of the previous level
+ *   - the compare A interrupt runs in the middle of the stop bit, and completes the character
+ *     (the trailing bits at 1 do not have any edge)
+ *   - start bit, even parity and stop bit are checked, and the bad characters are counted and dropped.
+ *
+ * It exposes the same byte-source interface than SoftwareSerial: begin(), available(), read().
+ * The count of Timer1 ticks (i.e. CPU cycles) spent in the interrupts for the last character, and the
+ * max of it, are available for measurement, and sent as 'isr=' on the timing child. They have not been
+ * measured on a target yet (see TODO #6).
+ *
+ * Timer1 is so dedicated to this class. It runs free with no prescaler, with the noise canceler on.
+ *
+ * pwi 2026-10-18 v1 creation
+ */
+
+// uncomment to receive the TIC on D8 with this class rather than with SoftwareSerial on D4
+//#define ICPSERIAL
+
+#define ICPSERIAL_RX_PIN      8         /* ICP1 */
+#define ICPSERIAL_BUFSIZE     64        /* as SoftwareSerial */
+#define ICPSERIAL_BITS        10        /* start, 7 data, parity, stop */
+#define ICPSERIAL_INV_SHIFT   20
+
+class icpSerial
+{
+    public:
+                                  icpSerial( uint8_t rxPin, uint8_t txPin );
+                int               available( void );
+                void              begin( long speed );
+                uint16_t          getCycles( void );
+                uint16_t          getCyclesMax( void );
+                uint16_t          getErrors( void );
+                int               read( void );
+
+        static  void              CaptureIsr( void );
+        static  void              CompareIsr( void );
+
+    private:
+        static  void              Complete( uint16_t enter );
+        static  void              Fill( uint16_t now );
+
+        static  volatile uint8_t  st_buffer[ICPSERIAL_BUFSIZE];
+        static  volatile uint8_t  st_head;
+        static  volatile uint8_t  st_tail;
+        static  volatile uint16_t st_errors;        /* framing and parity errors */
+        static  volatile uint16_t st_cycles;        /* cycles in the interrupts for the last character */
+        static  volatile uint16_t st_cycles_max;
+        static  uint16_t          st_bit;           /* ticks per bit */
+        static  uint16_t          st_inv;           /* 2^ICPSERIAL_INV_SHIFT / st_bit */
+        static  uint16_t          st_start;         /* time of the start bit edge */
+        static  uint16_t          st_last;          /* time of the last edge */
+        static  uint16_t          st_frame;         /* received bits, start bit first */
+        static  uint16_t          st_acc;           /* cycles accumulated for the current character */
+        static  uint8_t           st_pos;           /* count of received bits */
+        static  uint8_t           st_level;         /* level since the last edge */
+        static  bool              st_in_char;
+};
+
+#endif // __ICPSERIAL_H__
@@ -25,16 +25,41 @@
    pwi 2025- 9-30 v4.0-2025
                   review the whole children identifiers and types (align on mysCellar, adapt to HA)
                   let the ignored labels be sent to the gateway
-
+   pwi 2026-10-18 v4.1-2026
+                  eeprom is a wear-levelled log with lazy writes
+                  replace pwiTimer with a hierarchical timer wheel
+                  low-power idle mode
+                  adaptive report pacing
+                  decode the STGE status register
+                  local load shedding rules
+                  optional Timer1 input capture reception
+                  measure the loop latency and the free SRAM low-water mark
+                  fast startup: decode from the boot, skip an already known presentation
+                  decode the producer groups, and derive the net power
+                  daily and monthly energy accounting on the meter DATE
+                  SINSTS/PREF sizing histogram
+                  non-blocking priority send queues
+                  incremental resync on the trame sequence numbers
+                  optional raw TIC capture on the debug serial port
+
+v4.0-2025:
 Sketch uses 23126 bytes (75%) of program storage space. Maximum is 30720 bytes.
 Global variables use 1170 bytes (57%) of dynamic memory, leaving 991 bytes for local variables. Maximum is 2048 bytes.
+
+v4.1-2026: not yet built for the target, the figures below are estimated from a packed host build
+  (build/ticbench.cpp, which replays a simulated TIC stream through the Linky class on the host)
+  Linky object about 1000 bytes (about 450 in v4.0-2025): the two reception buffers are 48 bytes each,
+  PJOURF+1 being converted on the fly, and the horodates are packed in 32 bits
+  Global variables about 1750 bytes (85%), leaving about 300 bytes for the stack;
+  check the 'sram=' low-water mark reported on the load child after a first run
 */
 
 // uncomment for debugging this sketch
 #define SKETCH_DEBUG
 
 static char const sketchName[] PROGMEM    = "mysTeleinfo";
-static char const sketchVersion[] PROGMEM = "4.0-2025";
+static char const sketchVersion[] PROGMEM = "4.1-2026";
+static char const sketchBuild[] PROGMEM   = __DATE__ " " __TIME__;
 
 /* **********************************************************************************************************
    **********************************************************************************************************
@@ -54,13 +79,15 @@ static char const sketchVersion[] PROGMEM = "4.0-2025";
 
 MyMessage msg;
 
+#include <avr/sleep.h>
+
 /*
  * Declare our classes
  */
 #include <pwiCommon.h>
 
-#include <pwiTimer.h>
-pwiTimer autodump_timer;
+#include "wheelTimer.h"
+wheelTimer autodump_timer;
 
 #include "childids.h"
 #include "eeprom.h"
@@ -80,15 +107,23 @@ sEeprom eeprom;
  * Note that, according to the documentation, standard TIC frames are sent every 1s.
  * 
  * teleInfo
- * - rxPin:  D4 (PCINT2 - Port D)
+ * - rxPin:  D4 (PCINT2 - Port D), or D8 (ICP1) when ICPSERIAL is defined (see icpSerial.h)
  * - ledPin: D5
  * - hcPin:  D6
  * - hpPin:  D7
  * 
+ * Load shedding rules may drive D3 or A0..A5 (the other pins are used by the LEDs and the radio).
+ * A rule is configured as a 'type,arg,frames,pin' text, e.g. '1,90,3,14' sets A0 while SINSTS
+ * is above 90% of PREF during 3 consecutive trames, and '3,15,3,15' sets A1 while more than 1500 VA
+ * are injected (producer meters, see Linky.h).
  */
 
 #include "Linky.h"
+#ifdef ICPSERIAL
+Linky linky( CHILD_TI, ICPSERIAL_RX_PIN, 5, 6, 7 );
+#else
 Linky linky( CHILD_TI, 4, 5, 6, 7 );
+#endif
 bool linky_initial_sent = false;
 
 /* **********************************************************************************************************
@@ -99,19 +134,99 @@ bool linky_initial_sent = false;
 bool main_initial_sents = false;
 bool main_log_initial_sent = false;
 
-void mainPresentation()
+/* send queue: the replies to the controller and the reports of the sketch are queued as a bitset of
+ *  main_send_t, and sent one per loop() once the Linky queues have nothing to send, with their pacing
+ */
+typedef enum {
+    msd_reset = 0,
+    msd_dump,
+    msd_histogram,
+    msd_log_ignored,
+    msd_low_power,
+    msd_auto_dump,
+    msd_min_period,
+    msd_max_period,
+    msd_rule1,
+    msd_duty_cycle = msd_rule1+EEPROM_RULES,
+    msd_load,
+    msd_sram,
+    msd_log_ready,
+    msd_log_reset,
+    msd_log_dump,
+    msd_log_invalid,
+    msd_count
+}
+  main_send_t;
+
+uint32_t main_pend = 0;
+
+/* fast startup: the presentation is sent again only when the build has changed since the last complete
+ *  presentation (or when the controller requests it); the parameters are then sent on dump only
+ *  a presentation is complete when the controller has echoed its last message (see receive())
+ */
+bool main_booting = true;
+bool main_presented = false;
+uint16_t main_layout_pend = 0;
+
+/* low-power idle mode: the MCU sleeps until the next interrupt when neither the TIC nor the timers have
+ *  anything to do; the duty cycle is measured since the last report
+ */
+unsigned long main_duty_start_ms = 0;
+unsigned long main_duty_idle_ms = 0;
+unsigned long main_duty_idle_us = 0;
+
+/* real-time load: the max duration of a loop() iteration (sleep excluded) since the last report, and the
+ *  lowest count of never-used bytes between the heap and the stack since the boot; the free SRAM is painted
+ *  with a canary before the constructors run, and the canary bytes which are still intact are counted
+ */
+#define MAIN_SRAM_CANARY  0xc5
+
+unsigned long main_loop_max_us = 0;
+
+extern uint8_t __heap_start;
+
+void mainSramPaint( void ) __attribute__(( naked, used, section( ".init3" )));
+void mainSramPaint( void )
+{
+    for( uint8_t *p = &__heap_start ; p < ( uint8_t * ) SP ; ++p ){
+        *p = MAIN_SRAM_CANARY;
+    }
+}
+
+bool mainPresentation()
 {
 #ifdef SKETCH_DEBUG
     Serial.println( F( "mainPresentation()" ));
 #endif
+    bool ok = true;
     //                                                    1234567890123456789012345
-    present( CHILD_MAIN_LOG,                S_INFO,   F( "Board logs" ));
-    present( CHILD_MAIN_ACTION_RESET,       S_BINARY, F( "Action: reset eeprom" ));
-    present( CHILD_MAIN_ACTION_DUMP,        S_BINARY, F( "Action: dump eeprom" ));
-    present( CHILD_MAIN_ACTION_LOG_IGNORED, S_BINARY, F( "Action: log ignored" ));
-    present( CHILD_MAIN_PARM_DUMP_PERIOD,   S_INFO,   F( "Parm: eeprom dump period" ));
-    present( CHILD_MAIN_PARM_MIN_PERIOD,    S_INFO,   F( "Parm: report min period" ));
-    present( CHILD_MAIN_PARM_MAX_PERIOD,    S_INFO,   F( "Parm: report max period" ));
+    linky.presentWait();
+    ok &= present( CHILD_MAIN_ACTION_RESET,       S_BINARY, F( "Action: reset eeprom" ));
+    linky.presentWait();
+    ok &= present( CHILD_MAIN_ACTION_DUMP,        S_BINARY, F( "Action: dump eeprom" ));
+    linky.presentWait();
+    ok &= present( CHILD_MAIN_ACTION_LOG_IGNORED, S_BINARY, F( "Action: log ignored" ));
+    linky.presentWait();
+    ok &= present( CHILD_MAIN_ACTION_LOW_POWER,   S_BINARY, F( "Action: low-power idle" ));
+    linky.presentWait();
+    ok &= present( CHILD_MAIN_DUTY_CYCLE,         S_INFO,   F( "Duty cycle (%)" ));
+    linky.presentWait();
+    ok &= present( CHILD_MAIN_LOAD,               S_INFO,   F( "Loop max (us), free SRAM" ));
+    linky.presentWait();
+    ok &= present( CHILD_MAIN_ACTION_HISTOGRAM,   S_BINARY, F( "Action: dump histogram" ));
+    linky.presentWait();
+    ok &= present( CHILD_MAIN_ACTION_RESYNC,      S_INFO,   F( "Action: resync since seq" ));
+    linky.presentWait();
+    ok &= present( CHILD_MAIN_PARM_DUMP_PERIOD,   S_INFO,   F( "Parm: eeprom dump period" ));
+    linky.presentWait();
+    ok &= present( CHILD_MAIN_PARM_MIN_PERIOD,    S_INFO,   F( "Parm: report min period" ));
+    linky.presentWait();
+    ok &= present( CHILD_MAIN_PARM_MAX_PERIOD,    S_INFO,   F( "Parm: report max period" ));
+    linky.presentWait();
+    ok &= present( CHILD_MAIN_PARM_RULE1,         S_INFO,   F( "Parm: shedding rule 1" ));
+    linky.presentWait();
+    ok &= present( CHILD_MAIN_PARM_RULE2,         S_INFO,   F( "Parm: shedding rule 2" ));
+    return( ok );
 }
 
 void mainSetup()
@@ -119,14 +234,13 @@ void mainSetup()
 #ifdef SKETCH_DEBUG
     Serial.println( F( "mainSetup()" ));
 #endif
-    autodump_timer.setup( "AutoDump", eeprom.auto_dump_ms, false, ( pwiTimerCb ) mainAutoDumpCb );
+    autodump_timer.setup( "AutoDump", eeprom.auto_dump_ms, false, ( wheelTimerCb ) mainAutoDumpCb );
     autodump_timer.start();
-    mainActionResetSend();
-    mainActionDumpSend();
-    mainActionLogIgnoredSend();
-    mainAutoDumpSend();
-    mainMinPeriodSend();
-    mainMaxPeriodSend();
+    if( !main_presented ){
+        main_initial_sents = true;
+        return;
+    }
+    mainQueue( msd_reset, msd_duty_cycle-1 );
     main_initial_sents = true;
 }
 
@@ -136,7 +250,7 @@ void mainSetup()
 void mainInitialLoop( void )
 {
     if( main_initial_sents && linky_initial_sent && !main_log_initial_sent ){
-        mainLogSend(( char * ) "Node ready" );
+        mainQueue( msd_log_ready, msd_log_ready );
         main_log_initial_sent = true;
     }
 }
@@ -160,7 +274,29 @@ void mainActionDumpSend()
     Serial.println( payload );
 #endif
     msg.clear();
-    send( msg.setSensor( sensor_id ).setType( msg_type ).set( payload ));
+    linky.sendMsg( msg.setSensor( sensor_id ).setType( msg_type ).set( payload ));
+}
+
+void mainActionHistogramDo()
+{
+    linky.histogramSend( CHILD_MAIN_ACTION_HISTOGRAM );
+}
+
+void mainActionHistogramSend()
+{
+    uint8_t sensor_id = CHILD_MAIN_ACTION_HISTOGRAM;
+    uint8_t msg_type = V_STATUS;
+    uint8_t payload = 0;
+#ifdef SKETCH_DEBUG
+    Serial.print( F( "[mainActionHistogramSend] sensor=" ));
+    Serial.print( sensor_id );
+    Serial.print( F( ", type=" ));
+    Serial.print( msg_type );
+    Serial.print( F( ", payload=" ));
+    Serial.println( payload );
+#endif
+    msg.clear();
+    linky.sendMsg( msg.setSensor( sensor_id ).setType( msg_type ).set( payload ));
 }
 
 void mainActionLogIgnoredSet( bool status )
@@ -182,7 +318,30 @@ void mainActionLogIgnoredSend()
     Serial.println( payload );
 #endif
     msg.clear();
-    send( msg.setSensor( sensor_id ).setType( msg_type ).set( payload ));
+    linky.sendMsg( msg.setSensor( sensor_id ).setType( msg_type ).set( payload ));
+}
+
+void mainActionLowPowerSet( bool status )
+{
+    eeprom.low_power = status;
+    eepromSchedule();
+}
+
+void mainActionLowPowerSend()
+{
+    uint8_t sensor_id = CHILD_MAIN_ACTION_LOW_POWER;
+    uint8_t msg_type = V_STATUS;
+    uint8_t payload = eeprom.low_power;
+#ifdef SKETCH_DEBUG
+    Serial.print( F( "[mainActionLowPowerSend] sensor=" ));
+    Serial.print( sensor_id );
+    Serial.print( F( ", type=" ));
+    Serial.print( msg_type );
+    Serial.print( F( ", payload=" ));
+    Serial.println( payload );
+#endif
+    msg.clear();
+    linky.sendMsg( msg.setSensor( sensor_id ).setType( msg_type ).set( payload ));
 }
 
 void mainActionResetDo()
@@ -204,7 +363,7 @@ void mainActionResetSend()
     Serial.println( payload );
 #endif
     msg.clear();
-    send( msg.setSensor( sensor_id ).setType( msg_type ).set( payload ));
+    linky.sendMsg( msg.setSensor( sensor_id ).setType( msg_type ).set( payload ));
 }
 
 void mainAutoDumpCb( void*empty )
@@ -215,21 +374,90 @@ void mainAutoDumpCb( void*empty )
 void mainAutoDumpSend()
 {
     msg.clear();
-    send( msg.setSensor( CHILD_MAIN_ACTION_DUMP ).setType( V_TEXT ).set( eeprom.auto_dump_ms ));
+    linky.sendMsg( msg.setSensor( CHILD_MAIN_ACTION_DUMP ).setType( V_TEXT ).set( eeprom.auto_dump_ms ));
 }
 
 void mainAutoDumpSet( unsigned long ulong )
 {
     eeprom.auto_dump_ms = ulong;
-    eepromWrite( eeprom, saveState );
+    eepromSchedule();
     autodump_timer.setDelay( ulong );
     autodump_timer.restart();
 }
 
+/* send the percentage of time the MCU has been active since the last report, and restart the measure
+ */
+void mainDutyCycleSend()
+{
+    unsigned long now = millis();
+    unsigned long elapsed = now - main_duty_start_ms;
+    float payload = elapsed ? 100.0 * ( elapsed - main_duty_idle_ms ) / elapsed : 100.0;
+#ifdef SKETCH_DEBUG
+    Serial.print( F( "[mainDutyCycleSend] elapsed_ms=" ));
+    Serial.print( elapsed );
+    Serial.print( F( ", idle_ms=" ));
+    Serial.print( main_duty_idle_ms );
+    Serial.print( F( ", payload=" ));
+    Serial.println( payload );
+#endif
+    msg.clear();
+    linky.sendMsg( msg.setSensor( CHILD_MAIN_DUTY_CYCLE ).setType( V_TEXT ).set( payload, 1 ));
+    main_duty_start_ms = now;
+    main_duty_idle_ms = 0;
+    main_duty_idle_us = 0;
+}
+
+/* called from main loop() function
+ * sleep until the next interrupt (at most the 1ms Timer0 tick, or a TIC character) when there is nothing
+ * to do; the idle mode keeps the timers, the SPI radio and the pin change interrupts running
+ */
+void mainIdle()
+{
+    if( eeprom.low_power && linky.isIdle() && wheelTimer::NextDeadline() > 0 ){
+        unsigned long start = micros();
+        set_sleep_mode( SLEEP_MODE_IDLE );
+        sleep_mode();
+        main_duty_idle_us += micros() - start;
+        if( main_duty_idle_us >= 1000000 ){
+            main_duty_idle_ms += 1000;
+            main_duty_idle_us -= 1000000;
+        }
+    }
+}
+
+/* identify the build, so that an unchanged presentation can be skipped at boot
+ * djb2 hash of the build date and time, never zero
+ */
+uint16_t mainLayout()
+{
+    uint16_t h = 5381;
+    char c;
+    for( const char *p = sketchBuild ; ( c = pgm_read_byte( p )) ; ++p ){
+        h = ( h << 5 ) + h + c;
+    }
+    return( h ? h : 1 );
+}
+
+/* send the max loop duration as 'loop=us', then restart it
+ */
+void mainLoadSend()
+{
+    char payload[1+MAX_PAYLOAD];
+#ifdef SKETCH_DEBUG
+    Serial.print( F( "[mainLoadSend] loop_max_us=" ));
+    Serial.println( main_loop_max_us );
+#endif
+    strcpy( payload, "loop=" );
+    ultoa( main_loop_max_us, payload+strlen( payload ), 10 );
+    msg.clear();
+    linky.sendMsg( msg.setSensor( CHILD_MAIN_LOAD ).setType( V_TEXT ).set( payload ));
+    main_loop_max_us = 0;
+}
+
 void mainLogSend( char *log )
 {
     msg.clear();
-    send( msg.setSensor( CHILD_MAIN_LOG ).setType( V_TEXT ).set( log ));
+    linky.sendMsg( msg.setSensor( CHILD_MAIN_LOG ).setType( V_TEXT ).set( log ));
 }
 
 void mainMaxPeriodSend()
@@ -246,13 +474,14 @@ void mainMaxPeriodSend()
     Serial.println( payload );
 #endif
     msg.clear();
-    send( msg.setSensor( sensor_id ).setType( msg_type ).set( payload ));
+    linky.sendMsg( msg.setSensor( sensor_id ).setType( msg_type ).set( payload ));
 }
 
 void mainMaxPeriodSet( unsigned long ulong )
 {
     eeprom.max_period_ms = ulong;
-    eepromWrite( eeprom, saveState );
+    eepromSchedule();
+    linky.setPeriods( eeprom.min_period_ms, eeprom.max_period_ms );
 }
 
 void mainMinPeriodSend()
@@ -269,13 +498,162 @@ void mainMinPeriodSend()
     Serial.println( payload );
 #endif
     msg.clear();
-    send( msg.setSensor( sensor_id ).setType( msg_type ).set( payload ));
+    linky.sendMsg( msg.setSensor( sensor_id ).setType( msg_type ).set( payload ));
 }
 
 void mainMinPeriodSet( unsigned long ulong )
 {
     eeprom.min_period_ms = ulong;
-    eepromWrite( eeprom, saveState );
+    eepromSchedule();
+    linky.setPeriods( eeprom.min_period_ms, eeprom.max_period_ms );
+}
+
+/* queue the main_send_t items from first to last
+ */
+void mainQueue( uint8_t first, uint8_t last )
+{
+    for( uint8_t i=first ; i<=last ; ++i ){
+        bitSet( main_pend, i );
+    }
+}
+
+/* send a load shedding rule as a 'type,arg,frames,pin' text
+ */
+void mainRuleSend( uint8_t idx )
+{
+    uint8_t sensor_id = CHILD_MAIN_PARM_RULE1+idx;
+    uint8_t msg_type = V_TEXT;
+    const uint8_t *rule = ( const uint8_t * ) &eeprom.rules[idx];
+    char payload[1+4*4];
+    char *p = payload;
+    for( uint8_t i=0 ; i<sizeof( sRule ) ; ++i ){
+        if( i ){
+            *p++ = ',';
+        }
+        utoa( rule[i], p, 10 );
+        p += strlen( p );
+    }
+#ifdef SKETCH_DEBUG
+    Serial.print( F( "[mainRuleSend] sensor=" ));
+    Serial.print( sensor_id );
+    Serial.print( F( ", type=" ));
+    Serial.print( msg_type );
+    Serial.print( F( ", payload=" ));
+    Serial.println( payload );
+#endif
+    msg.clear();
+    linky.sendMsg( msg.setSensor( sensor_id ).setType( msg_type ).set( payload ));
+}
+
+/* parse a 'type,arg,frames,pin' text
+ * returns false if the rule is not valid
+ */
+bool mainRuleSet( uint8_t idx, char *payload )
+{
+    sRule rule;
+    uint8_t *p = ( uint8_t * ) &rule;
+    char *s = payload;
+    for( uint8_t i=0 ; i<sizeof( sRule ) ; ++i ){
+        char *end;
+        unsigned long value = strtoul( s, &end, 10 );
+        if( end == s || value > 255 || *end != ( i < sizeof( sRule )-1 ? ',' : '\0' )){
+            return( false );
+        }
+        p[i] = value;
+        s = end+1;
+    }
+    if( rule.type > RULE_SURPLUS || ( rule.pin && rule.pin != 3 && ( rule.pin < A0 || rule.pin > A5 ))){
+        return( false );
+    }
+    eeprom.rules[idx] = rule;
+    eepromSchedule();
+    linky.setRules( eeprom.rules );
+    return( true );
+}
+
+/* called from main loop() function, after linky.loop()
+ * send at most one queued message, only when Linky has had nothing to send
+ */
+void mainSendNext( void )
+{
+    if( !main_pend || !linky.sendReady()){
+        return;
+    }
+    uint8_t i = 0;
+    while( !bitRead( main_pend, i )){
+        i += 1;
+    }
+    bitClear( main_pend, i );
+    switch( i ){
+        case msd_reset:
+            mainActionResetSend();
+            break;
+        case msd_dump:
+            mainActionDumpSend();
+            break;
+        case msd_histogram:
+            mainActionHistogramSend();
+            break;
+        case msd_log_ignored:
+            mainActionLogIgnoredSend();
+            break;
+        case msd_low_power:
+            mainActionLowPowerSend();
+            break;
+        case msd_auto_dump:
+            mainAutoDumpSend();
+            break;
+        case msd_min_period:
+            mainMinPeriodSend();
+            break;
+        case msd_max_period:
+            mainMaxPeriodSend();
+            break;
+        case msd_duty_cycle:
+            mainDutyCycleSend();
+            break;
+        case msd_load:
+            mainLoadSend();
+            break;
+        case msd_sram:
+            mainSramSend();
+            break;
+        case msd_log_ready:
+            mainLogSend(( char * ) "Node ready" );
+            break;
+        case msd_log_reset:
+            mainLogSend(( char * ) "eeprom reset done" );
+            break;
+        case msd_log_dump:
+            mainLogSend(( char * ) "eeprom dump done" );
+            break;
+        case msd_log_invalid:
+            //                      1234567890123456789012345
+            mainLogSend(( char * ) "Unknowned or invalid msg" );
+            break;
+        default:
+            mainRuleSend( i-msd_rule1 );
+            break;
+    }
+}
+
+/* send the free SRAM low-water mark as 'sram=bytes'
+ */
+void mainSramSend()
+{
+    char payload[1+MAX_PAYLOAD];
+    uint16_t sram = 0;
+    for( uint8_t *p = &__heap_start ; p < ( uint8_t * ) SP && *p == MAIN_SRAM_CANARY ; ++p ){
+        sram += 1;
+    }
+#ifdef SKETCH_DEBUG
+    Serial.print( F( "[mainSramSend] sram=" ));
+    Serial.println( sram );
+#endif
+    strcpy( payload, "sram=" );
+    utoa( sram, payload+strlen( payload ), 10 );
+    msg.clear();
+    linky.sendMsg( msg.setSensor( CHILD_MAIN_LOAD ).setType( V_TEXT ).set( payload ));
 }
 
 /* **********************************************************************************************************
@@ -284,40 +662,73 @@ void mainMinPeriodSet( unsigned long ulong )
  * **********************************************************************************************************
  * ********************************************************************************************************** */
 
-void presentation()
+/* called by MySensors before the radio is initialized
+ * start the TIC reception as soon as possible, so that no trame is lost during the presentation
+ */
+void before()
 {
 #ifdef SKETCH_DEBUG
-    Serial.println( F( "presentation()" ));
+    Serial.begin( 115200 );
+    Serial.println( F( "before()" ));
 #endif
+    //eepromReset( eeprom, saveState );
+    eepromRead( eeprom, loadState, saveState );
+    eepromDump( eeprom );
 
-    mainPresentation();
-    linky.present();
+    linky.setup( eeprom.min_period_ms, eeprom.max_period_ms );
+    linky.setRules( eeprom.rules );
+}
+
+/* also called when the controller requests the presentation
+ */
+void presentation()
+{
+    uint16_t layout = mainLayout();
+#ifdef SKETCH_DEBUG
+    Serial.print( F( "presentation() layout=" ));
+    Serial.println( layout );
+#endif
+    if( main_booting && eeprom.layout == layout ){
+        return;
+    }
+    /* the layout is unknown until the last message is echoed */
+    if( eeprom.layout ){
+        eeprom.layout = 0;
+        eepromSchedule();
+    }
+    bool ok = sendSketchInfo( PGMSTR( sketchName ), PGMSTR( sketchVersion ));
+    ok &= mainPresentation();
+    ok &= linky.present();
+    main_presented = true;
+
+    main_layout_pend = ok ? layout : 0;
+    linky.presentWait();
+    present( CHILD_MAIN_LOG, S_INFO, F( "Board logs" ), true );
 }
 
 void setup()  
 {
 #ifdef SKETCH_DEBUG
-    Serial.begin( 115200 );
     Serial.println( F( "setup()" ));
 #endif
-    sendSketchInfo( PGMSTR( sketchName ), PGMSTR( sketchVersion ));
-
-    //eepromReset( eeprom, saveState );
-    eepromRead( eeprom, loadState, saveState );
-    eepromDump( eeprom );
-
+    main_booting = false;
     mainSetup();
-    linky.setup( eeprom.min_period_ms, eeprom.max_period_ms );
     linky_initial_sent = true;
 }
 
 void loop()
 {
+    unsigned long start = micros();
     mainInitialLoop();
-    pwiTimer::Loop();
-    if( main_log_initial_sent ){
-        linky.loop();
+    wheelTimer::Loop();
+    eepromLoop( eeprom, saveState );
+    linky.loop();
+    mainSendNext();
+    unsigned long elapsed = micros() - start;
+    if( elapsed > main_loop_max_us ){
+        main_loop_max_us = elapsed;
     }
+    mainIdle();
 }
 
 void receive( const MyMessage &message )
@@ -341,6 +752,16 @@ void receive( const MyMessage &message )
     Serial.println( F( "'" ));
 #endif
 
+    /* the echo of the last presentation: the controller has got the whole layout */
+    if( cmd == C_PRESENTATION ){
+        if( message.isAck() && message.sensor == CHILD_MAIN_LOG && main_layout_pend ){
+            eeprom.layout = main_layout_pend;
+            eepromSchedule();
+            main_layout_pend = 0;
+        }
+        return;
+    }
+
     if( cmd == C_SET ){
         uint8_t ureq = strlen( payload ) > 0 ? atoi( payload ) : 0;
         unsigned long ulong = strlen( payload ) ? atol( payload ) : 0;
@@ -348,62 +769,110 @@ void receive( const MyMessage &message )
             case CHILD_MAIN_ACTION_RESET:
                 if( message.type == V_STATUS && ureq == 1 ){
                     mainActionResetDo();
-                    mainActionResetSend();
-                    mainLogSend(( char * ) "eeprom reset done" );
+                    mainQueue( msd_reset, msd_reset );
+                    mainQueue( msd_log_reset, msd_log_reset );
                     valid = true;
                 }
                 break;
             case CHILD_MAIN_ACTION_DUMP:
                 if( message.type == V_STATUS && ureq == 1 ){
                     mainActionDumpDo();
-                    mainActionDumpSend();
-                    mainLogSend(( char * ) "eeprom dump done" );
+                    mainQueue( msd_dump, msd_dump );
+                    mainQueue( msd_log_dump, msd_log_dump );
+                    valid = true;
+                }
+                break;
+            case CHILD_MAIN_ACTION_HISTOGRAM:
+                if( message.type == V_STATUS && ureq == 1 ){
+                    mainActionHistogramDo();
+                    mainQueue( msd_histogram, msd_histogram );
+                    valid = true;
+                }
+                break;
+            case CHILD_MAIN_ACTION_RESYNC:
+                if( message.type == V_TEXT && strlen( payload )){
+                    linky.resync( ulong );
                     valid = true;
                 }
                 break;
             case CHILD_MAIN_ACTION_LOG_IGNORED:
                 if( message.type == V_STATUS ){
                     mainActionLogIgnoredSet( ureq );
-                    mainActionLogIgnoredSend();
+                    mainQueue( msd_log_ignored, msd_log_ignored );
+                    valid = true;
+                }
+                break;
+            case CHILD_MAIN_ACTION_LOW_POWER:
+                if( message.type == V_STATUS ){
+                    mainActionLowPowerSet( ureq );
+                    mainQueue( msd_low_power, msd_low_power );
                     valid = true;
                 }
                 break;
             case CHILD_MAIN_PARM_DUMP_PERIOD:
                 if( message.type == V_TEXT && strlen( payload )){
                     mainAutoDumpSet( ulong );
-                    mainAutoDumpSend();
+                    mainQueue( msd_auto_dump, msd_auto_dump );
                     valid = true;
                 }
                 break;
             case CHILD_MAIN_PARM_MAX_PERIOD:
                 if( message.type == V_TEXT && strlen( payload )){
                     mainMaxPeriodSet( ulong );
-                    mainMaxPeriodSend();
+                    mainQueue( msd_max_period, msd_max_period );
                     valid = true;
                 }
                 break;
             case CHILD_MAIN_PARM_MIN_PERIOD:
                 if( message.type == V_TEXT && strlen( payload )){
                     mainMinPeriodSet( ulong );
-                    mainMinPeriodSend();
+                    mainQueue( msd_min_period, msd_min_period );
+                    valid = true;
+                }
+                break;
+            case CHILD_MAIN_PARM_RULE1:
+            case CHILD_MAIN_PARM_RULE2:
+                if( message.type == V_TEXT && mainRuleSet( message.sensor-CHILD_MAIN_PARM_RULE1, payload )){
+                    mainQueue( msd_rule1+message.sensor-CHILD_MAIN_PARM_RULE1, msd_rule1+message.sensor-CHILD_MAIN_PARM_RULE1 );
                     valid = true;
                 }
                 break;
         }
     } // end of cmd == C_SET
 
+    if( cmd == C_REQ ){
+        switch( message.sensor ){
+            case CHILD_ID_ERRORS:
+                linky.errorsSend();
+                valid = true;
+                break;
+            case CHILD_ID_TIMING:
+                linky.timingSend();
+                valid = true;
+                break;
+            case CHILD_ID_QUEUES:
+                linky.queuesSend();
+                valid = true;
+                break;
+            case CHILD_MAIN_ACTION_RESYNC:
+                linky.seqSend();
+                valid = true;
+                break;
+            case CHILD_MAIN_LOAD:
+                mainQueue( msd_load, msd_sram );
+                valid = true;
+                break;
+        }
+    } // end of cmd == C_REQ
+
     if( !valid ){
-        //                      1234567890123456789012345
-        mainLogSend(( char * ) "Unknowned or invalid msg" );
+        mainQueue( msd_log_invalid, msd_log_invalid );
     }
 }
 
 void dumpData()
 {
-    mainActionLogIgnoredSend();
-    mainMaxPeriodSend();
-    mainMinPeriodSend();
-    mainAutoDumpSend();
+    mainQueue( msd_log_ignored, msd_sram );
     linky.send( true );
 }
 
@@ -0,0 +1,303 @@
+#include "wheelTimer.h"
+
+/* **********************************************************************************************************
+ * A hierarchical timer wheel.
+ *
+ * pwi 2026-10-18 v1 creation
+ */
+
+wheelTimer   *wheelTimer::st_wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+uint32_t      wheelTimer::st_tick_ms = 0;
+
+/* ticks are counted modulo 2^(32-WHEEL_TICK_SHIFT), so that they wrap together with millis()
+ */
+#define TICK_MASK       ( 0xffffffffUL >> WHEEL_TICK_SHIFT )
+#define SLOT_MASK       ( WHEEL_SLOTS-1 )
+
+/**
+ * wheelTimer::wheelTimer:
+ *
+ * Constructor.
+ *
+ * Public.
+ */
+wheelTimer::wheelTimer()
+{
+    this->next = NULL;
+    this->pprev = NULL;
+    this->expire = 0;
+    this->delay_ms = 0;
+#ifdef WHEELTIMER_DEBUG
+    this->label = NULL;
+#endif
+    this->cb = NULL;
+    this->user_data = NULL;
+    this->once = false;
+    this->running = false;
+}
+
+/**
+ * wheelTimer::getDelay:
+ *
+ * Returns: the configured delay in ms.
+ *
+ * Public.
+ */
+unsigned long wheelTimer::getDelay( void )
+{
+    return( this->delay_ms );
+}
+
+/**
+ * wheelTimer::isRunning:
+ *
+ * Returns: whether the timer is started.
+ *
+ * Public.
+ */
+bool wheelTimer::isRunning( void )
+{
+    return( this->running );
+}
+
+/**
+ * wheelTimer::restart:
+ *
+ * (Re)start the timer for a full delay from now.
+ *
+ * Public.
+ */
+void wheelTimer::restart( void )
+{
+    this->stop();
+    this->start();
+}
+
+/**
+ * wheelTimer::setDelay:
+ * @delay_ms: the new delay.
+ *
+ * The new delay will be considered at next (re)start or next period.
+ *
+ * Public.
+ */
+void wheelTimer::setDelay( unsigned long delay_ms )
+{
+    this->delay_ms = delay_ms;
+}
+
+/**
+ * wheelTimer::setup:
+ * @label: a label for debugging, only kept when WHEELTIMER_DEBUG is defined.
+ * @delay_ms: the delay.
+ * @once: whether the timer must run only once, or periodically.
+ * @cb: the callback.
+ * @user_data: the data passed to the callback.
+ *
+ * Public.
+ */
+void wheelTimer::setup( const char *label, unsigned long delay_ms, bool once, wheelTimerCb cb, void *user_data )
+{
+#ifdef WHEELTIMER_DEBUG
+    this->label = label;
+#else
+    ( void ) label;
+#endif
+    this->delay_ms = delay_ms;
+    this->once = once;
+    this->cb = cb;
+    this->user_data = user_data;
+}
+
+/**
+ * wheelTimer::start:
+ *
+ * Start the timer, if not already running.
+ *
+ * Public.
+ */
+void wheelTimer::start( void )
+{
+    if( !this->running && this->delay_ms > 0 ){
+        this->expire = ( uint32_t ) millis() + this->delay_ms;
+        this->running = true;
+        this->insert( wheelTimer::st_tick_ms+1 );
+#ifdef WHEELTIMER_DEBUG
+        Serial.print( F( "[wheelTimer::start] " )); Serial.print( this->label );
+        Serial.print( F( " expire=" )); Serial.println( this->expire );
+#endif
+    }
+}
+
+/**
+ * wheelTimer::stop:
+ *
+ * Stop the timer.
+ *
+ * Public.
+ */
+void wheelTimer::stop( void )
+{
+    if( this->running ){
+        this->unlink();
+        this->running = false;
+    }
+}
+
+/**
+ * wheelTimer::insert:
+ * @floor_ms: the minimal time at which the timer may expire.
+ *
+ * Chain the timer in the slot which corresponds to its expiration tick,
+ *  i.e. the first tick which is not before the expiration time.
+ *
+ * Private.
+ */
+void wheelTimer::insert( uint32_t floor_ms )
+{
+    uint32_t target = this->expire;
+    if(( int32_t )( target - floor_ms ) < 0 ){
+        target = floor_ms;
+    }
+    uint32_t cur = wheelTimer::st_tick_ms >> WHEEL_TICK_SHIFT;
+    uint32_t tick = (( target >> WHEEL_TICK_SHIFT ) + (( target & ( WHEEL_TICK_MS-1 )) ? 1 : 0 )) & TICK_MASK;
+    uint32_t delta = ( tick - cur ) & TICK_MASK;
+    wheelTimer **head;
+
+    if( delta < WHEEL_SLOTS ){
+        head = &wheelTimer::st_wheel[0][tick & SLOT_MASK];
+    } else if( delta < (( uint32_t ) 1 << ( 2*WHEEL_SLOT_BITS ))){
+        head = &wheelTimer::st_wheel[1][( tick >> WHEEL_SLOT_BITS ) & SLOT_MASK];
+    } else if( delta < (( uint32_t ) 1 << ( 3*WHEEL_SLOT_BITS ))){
+        head = &wheelTimer::st_wheel[2][( tick >> ( 2*WHEEL_SLOT_BITS )) & SLOT_MASK];
+    } else {
+        // beyond the span of the wheel: park it in the top slot which will be cascaded the latest
+        head = &wheelTimer::st_wheel[2][( cur >> ( 2*WHEEL_SLOT_BITS )) & SLOT_MASK];
+    }
+
+    this->next = *head;
+    if( *head ){
+        ( *head )->pprev = &this->next;
+    }
+    this->pprev = head;
+    *head = this;
+}
+
+/**
+ * wheelTimer::unlink:
+ *
+ * Remove the timer from its slot.
+ *
+ * Private.
+ */
+void wheelTimer::unlink( void )
+{
+    if( this->pprev ){
+        *this->pprev = this->next;
+    }
+    if( this->next ){
+        this->next->pprev = this->pprev;
+    }
+    this->next = NULL;
+    this->pprev = NULL;
+}
+
+/**
+ * wheelTimer::Cascade:
+ * @level: the level to be cascaded.
+ *
+ * Move down the timers of the current slot of @level.
+ *
+ * Static private.
+ */
+void wheelTimer::Cascade( uint8_t level )
+{
+    uint8_t idx = ( wheelTimer::st_tick_ms >> ( WHEEL_TICK_SHIFT+level*WHEEL_SLOT_BITS )) & SLOT_MASK;
+    wheelTimer *t = wheelTimer::st_wheel[level][idx];
+    wheelTimer::st_wheel[level][idx] = NULL;
+
+    while( t ){
+        wheelTimer *next = t->next;
+        t->insert( wheelTimer::st_tick_ms );
+        t = next;
+    }
+}
+
+/**
+ * wheelTimer::Loop:
+ *
+ * To be called from the main loop().
+ * Process the elapsed ticks, running the callbacks of the expired timers.
+ * When no tick has elapsed, this is just a subtraction and a comparison.
+ *
+ * Static public.
+ */
+void wheelTimer::Loop( void )
+{
+    while(( uint32_t ) millis() - wheelTimer::st_tick_ms >= WHEEL_TICK_MS ){
+        wheelTimer::st_tick_ms += WHEEL_TICK_MS;
+        uint32_t cur = wheelTimer::st_tick_ms >> WHEEL_TICK_SHIFT;
+
+        // cascade the upper levels when the lower ones wrap (top level first)
+        if(( cur & SLOT_MASK ) == 0 ){
+            if((( cur >> WHEEL_SLOT_BITS ) & SLOT_MASK ) == 0 ){
+                wheelTimer::Cascade( 2 );
+            }
+            wheelTimer::Cascade( 1 );
+        }
+
+        // run the expired timers
+        wheelTimer **head = &wheelTimer::st_wheel[0][cur & SLOT_MASK];
+        wheelTimer *t;
+        while(( t = *head ) != NULL ){
+            t->unlink();
+            if(( int32_t )( t->expire - wheelTimer::st_tick_ms ) > 0 ){
+                t->insert( wheelTimer::st_tick_ms+1 );
+                continue;
+            }
+            if( t->once ){
+                t->running = false;
+            } else {
+                // reschedule from the theorical expiration, unless we are late of more than one period
+                t->expire += t->delay_ms;
+                if(( int32_t )( t->expire - wheelTimer::st_tick_ms ) <= 0 ){
+                    t->expire = wheelTimer::st_tick_ms + t->delay_ms;
+                }
+                t->insert( wheelTimer::st_tick_ms+1 );
+            }
+            if( t->cb ){
+                t->cb( t->user_data );
+            }
+        }
+    }
+}
+
+/**
+ * wheelTimer::NextDeadline:
+ *
+ * Returns: the count of ms until the next tick where Loop() will have something to do,
+ *  i.e. either run a timer or cascade a non-empty slot.
+ *  Returns 0 if Loop() has ticks to process now.
+ *
+ * Static public.
+ */
+unsigned long wheelTimer::NextDeadline( void )
+{
+    uint32_t elapsed = ( uint32_t ) millis() - wheelTimer::st_tick_ms;
+    if( elapsed >= WHEEL_TICK_MS ){
+        return( 0 );
+    }
+    uint32_t cur = wheelTimer::st_tick_ms >> WHEEL_TICK_SHIFT;
+    for( uint8_t k=1 ; k<=( 1 << ( 2*WHEEL_SLOT_BITS )) ; ++k ){
+        uint32_t tick = cur + k;
+        bool work = ( wheelTimer::st_wheel[0][tick & SLOT_MASK] != NULL );
+        if(( tick & SLOT_MASK ) == 0 ){
+            work |= (( tick >> WHEEL_SLOT_BITS ) & SLOT_MASK ) == 0;
+            work |= ( wheelTimer::st_wheel[1][( tick >> WHEEL_SLOT_BITS ) & SLOT_MASK] != NULL );
+        }
+        if( work ){
+            return(( unsigned long ) k * WHEEL_TICK_MS - elapsed );
+        }
+    }
+    return(( 1UL << ( 2*WHEEL_SLOT_BITS )) * WHEEL_TICK_MS - elapsed );
+}
@@ -0,0 +1,80 @@
+#ifndef __WHEELTIMER_H__
+#define __WHEELTIMER_H__
+
+#include <Arduino.h>
+
+/* **********************************************************************************************************
+ * A hierarchical timer wheel.
+ *
+ * This is a drop-in replacement of the pwiTimer class: each instance is a timer, and the static Loop()
+ * method is to be called from the main loop(). Instead of polling each timer, the timers are chained in the
+ * slots of a wheel, indexed by their expiration tick:
+ *
+ *   level 0: WHEEL_SLOTS slots of 1 tick       (WHEEL_TICK_MS)
+ *   level 1: WHEEL_SLOTS slots of WHEEL_SLOTS ticks
+ *   level 2: WHEEL_SLOTS slots of WHEEL_SLOTS^2 ticks
+ *
+ * - inserting, stopping or restarting a timer is O(1)
+ * - each elapsed tick only examines one level 0 slot, the upper levels being cascaded down when the lower
+ *   level wraps
+ * - a timer which expires beyond the span of the wheel is parked in the last slot of the top level, and
+ *   re-cascaded until it comes in range
+ * - periodic timers are rescheduled from their theorical expiration, not from the time they have been
+ *   actually run, so that they do not drift even when the loop is late.
+ *
+ * NextDeadline() lets the caller know how long it may idle before the next timer expires.
+ *
+ * A timer is 17 bytes on the AVR: the label is only kept when debugging, and the flags are bits.
+ *
+ * pwi 2026-10-18 v1 creation
+ */
+
+// uncomment for debugging this class
+//#define WHEELTIMER_DEBUG
+
+#define WHEEL_TICK_SHIFT    4
+#define WHEEL_TICK_MS       ( 1 << WHEEL_TICK_SHIFT )
+#define WHEEL_SLOT_BITS     3
+#define WHEEL_SLOTS         ( 1 << WHEEL_SLOT_BITS )
+#define WHEEL_LEVELS        3
+
+typedef void ( *wheelTimerCb )( void * );
+
+class wheelTimer
+{
+    public:
+                                  wheelTimer();
+                unsigned long     getDelay( void );
+                bool              isRunning( void );
+                void              restart( void );
+                void              setDelay( unsigned long delay_ms );
+                void              setup( const char *label, unsigned long delay_ms, bool once, wheelTimerCb cb, void *user_data=NULL );
+                void              start( void );
+                void              stop( void );
+
+        static  void              Loop( void );
+        static  unsigned long     NextDeadline( void );
+
+    private:
+                wheelTimer       *next;
+                wheelTimer      **pprev;                    /* the pointer which points to us */
+                uint32_t          expire;                   /* expiration time (ms) */
+                uint32_t          delay_ms;
+#ifdef WHEELTIMER_DEBUG
+                const char       *label;
+#endif
+                wheelTimerCb      cb;
+                void             *user_data;
+                bool              once : 1;
+                bool              running : 1;
+
+                void              insert( uint32_t floor_ms );
+                void              unlink( void );
+
+        static  void              Cascade( uint8_t level );
+
+        static  wheelTimer       *st_wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+        static  uint32_t          st_tick_ms;               /* time of the last processed tick, a multiple of WHEEL_TICK_MS */
+};
+
+#endif // __WHEELTIMER_H__